@@ -38,7 +38,7 @@ binit(void)
 {
   struct buf *b;
 
-  initlock(&bcache.lock, "bcache");
+  initlockkind(&bcache.lock, "bcache", HOTLOCKKIND);
 
   // Create linked list of buffers
   bcache.head.prev = &bcache.head;
@@ -50,6 +50,8 @@ struct {
   uint r;  // Read index
   uint w;  // Write index
   uint e;  // Edit index
+
+  int fgpgid;  // Foreground process group, for ^C; 0 if none
 } cons;
 
 //
@@ -141,6 +143,14 @@ consoleintr(int c)
   case C('P'):  // Print process list.
     procdump();
     break;
+  case C('C'):  // Interrupt the foreground process group.
+    consputc('^');
+    consputc('C');
+    consputc('\n');
+    cons.e = cons.w;
+    if(cons.fgpgid > 0)
+      kill(-cons.fgpgid);
+    break;
   case C('U'):  // Kill line.
     while(cons.e != cons.w &&
           cons.buf[(cons.e-1) % INPUT_BUF] != '\n'){
@@ -178,6 +188,19 @@ consoleintr(int c)
   release(&cons.lock);
 }
 
+// Make process group pgid the one that ^C interrupts,
+// or none if pgid is 0.
+int
+consolesetpgrp(int pgid)
+{
+  if(pgid < 0)
+    return -1;
+  acquire(&cons.lock);
+  cons.fgpgid = pgid;
+  release(&cons.lock);
+  return 0;
+}
+
 void
 consoleinit(void)
 {
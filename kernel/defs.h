@@ -1,9 +1,13 @@
 struct buf;
 struct context;
+struct evring;
 struct file;
 struct inode;
+struct lockstat;
 struct pipe;
+struct rwspinlock;
 struct proc;
+struct rcuhead;
 struct spinlock;
 struct sleeplock;
 struct stat;
@@ -19,9 +23,29 @@ void            bunpin(struct buf*);
 
 // console.c
 void            consoleinit(void);
+int             consolesetpgrp(int);
 void            consoleintr(int);
 void            consputc(int);
 
+// edf.c
+void            edfinit(void);
+int             edfsetattr(uint64, uint64, uint64);
+struct proc*    edfpick(void);
+void            edfready(void);
+int             edfchanged(uint64*);
+void            edfstart(struct proc*);
+void            edfstop(struct proc*);
+int             edfyield(void);
+void            edftick(void);
+void            edfpreempt(struct proc*);
+
+// evring.c
+void            evringinit(struct evring*, void*, int, int);
+void*           evringslot(struct evring*);
+void            evringpush(struct evring*);
+void            evringskip(struct evring*);
+int             evringdrain(struct evring*, uint64, int);
+
 // exec.c
 int             exec(char*, char**);
 
@@ -42,9 +66,11 @@ struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit();
 void            ilock(struct inode*);
+void            ilockshared(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
 void            iunlockput(struct inode*);
+void            iunlockshared(struct inode*);
 void            iupdate(struct inode*);
 int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
@@ -59,11 +85,33 @@ void            ramdiskinit(void);
 void            ramdiskintr(void);
 void            ramdiskrw(struct buf*);
 
+// fpu.c
+int             fptrap(void);
+void            fpflush(void);
+void            fpreset(void);
+uint64          fpuserstatus(uint64);
+
+// futex.c
+void            futexinit(void);
+int             futex(uint64, int, int);
+
+// ipi.c
+void            ipiinit(void);
+void            ipiintr(void);
+int             ipikick(void);
+void            ipiresched(int);
+void            tlbshootdown(pagetable_t);
+
 // kalloc.c
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
 
+// lockdep.c, if built with LOCKDEP
+void            lockdepclass(struct lockstat*);
+void            lockdepacquire(struct lockstat*, uint64);
+void            lockdeprelease(struct lockstat*);
+
 // log.c
 void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
@@ -80,16 +128,34 @@ int             pipewrite(struct pipe*, uint64, int);
 void            printf(char*, ...);
 void            panic(char*) __attribute__((noreturn));
 void            printfinit(void);
+void            backtrace(void);
+
+// prof.c
+void            profinit(void);
+int             profstart(int);
+void            profintr(void);
+int             profdrain(uint64, int);
 
 // proc.c
+extern int      ncpu;
+int             clone(uint64, uint64, uint64);
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
-int             growproc(int);
-void            proc_mapstacks(pagetable_t);
+uint64          growproc(int);
+int             join(int, uint64);
+void            kstacktrim(void);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
 int             kill(int);
+void            charge(struct proc*, uint64*);
+int             getrusage(int, uint64);
+int             setpgid(int, int);
+int             getpgid(int);
+int             setpriority(int, int);
+void            seteprio(struct proc*, int);
+int             getpriority(int);
+int             procinfo(uint64, int);
 struct cpu*     mycpu(void);
 struct cpu*     getmycpu(void);
 struct proc*    myproc();
@@ -100,11 +166,20 @@ void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(uint64);
 void            wakeup(void*);
+void            wakeproc(struct proc*, void*);
 void            yield(void);
+void            cond_resched(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
 
+// start.c
+void            timerarm(uint64);
+void            timeridle(uint64);
+void            timerbusy(void);
+uint64          timerprof(uint64);
+uint64          timerprofnext(void);
+
 // swtch.S
 void            swtch(struct context*, struct context*);
 
@@ -112,16 +187,43 @@ void            swtch(struct context*, struct context*);
 void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
+void            initlockkind(struct spinlock*, char*, int);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
 
+// rcu.c
+void            rcuinit(void);
+void            rcu_read_lock(void);
+void            rcu_read_unlock(void);
+void            rcuquiescent(void);
+void            rcupoll(void);
+void            call_rcu(struct rcuhead*, void (*)(struct rcuhead*));
+void            synchronize_rcu(void);
+
+// rwlock.c
+void            initrwlock(struct rwspinlock*, char*);
+void            acquirerd(struct rwspinlock*);
+void            releaserd(struct rwspinlock*);
+void            acquirewr(struct rwspinlock*);
+void            releasewr(struct rwspinlock*);
+
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
+void            acquiresleepshared(struct sleeplock*);
+void            releasesleepshared(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
+// sprintf.c
+int             snprintf(char*, int, char*, ...);
+
+// stats.c
+void            statsinit(void);
+void            lockstatinit(struct lockstat*, char*, int);
+void            lockstatfree(struct lockstat*);
+
 // string.c
 int             memcmp(const void*, const void*, uint);
 void*           memmove(void*, const void*, uint);
@@ -146,6 +248,23 @@ void            trapinithart(void);
 extern struct spinlock tickslock;
 void            usertrapret(void);
 
+// sysinfo.c
+void            loadinit(void);
+void            calcload(void);
+int             sysinfo(uint64);
+
+// trace.c
+void            traceinit(void);
+void            traceevent(int, int, int);
+void            tracesyscall(int, uint64*, int, uint64);
+int             tracedrain(uint64, int);
+
+// twheel.c
+void            twinit(void);
+int             twsleep(uint64);
+void            twexpire(void);
+uint64          twnext(void);
+
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
@@ -166,6 +285,7 @@ int             uvmcopy(pagetable_t, pagetable_t, uint64);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
+pte_t *         walk(pagetable_t, uint64, int);
 uint64          walkaddr(pagetable_t, uint64);
 int             copyout(pagetable_t, uint64, char *, uint64);
 int             copyin(pagetable_t, char *, uint64, uint64);
@@ -0,0 +1,256 @@
+// Earliest-deadline-first scheduling for real-time processes.
+//
+// A process that calls sched_setattr(runtime, deadline, period)
+// asks for runtime of CPU time within deadline of the start of
+// every period.  Each period starts a new job, with a budget of
+// runtime and an absolute deadline.  The scheduler runs the
+// runnable real-time process with the earliest deadline ahead
+// of all normal processes, and a newly runnable one preempts
+// the least urgent running process.  A job ends when the
+// process calls sched_yield(), or is throttled when it uses up
+// its budget; either way it sleeps until its next period.
+//
+// Admission control keeps the total demand schedulable by
+// global EDF on ncpu harts, using the Goossens-Funk-Baruah
+// bound: the sum of the densities runtime/deadline may be at
+// most ncpu - (ncpu-1) * the largest density.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define UNIT (1L << 20)   // fixed-point density of 1.0
+
+extern struct proc *allproc;
+
+// edf.lock protects every process's dl_runtime, dl_deadline
+// and dl_period, and ndeadline.  p->lock protects the rest of
+// p's dl_ fields, the state of its current job.
+struct {
+  struct spinlock lock;
+  int ndeadline;     // number of real-time processes
+  uint64 nready;     // times one has become RUNNABLE; atomic
+} edf;
+
+void
+edfinit(void)
+{
+  initlock(&edf.lock, "edf");
+}
+
+static uint64
+density(struct proc *p)
+{
+  return p->dl_runtime * UNIT / p->dl_deadline;
+}
+
+// Make the current process real-time, with parameters in
+// nanoseconds, or a normal process again if runtime is 0.
+// Return -1 if the parameters are bad, or if admitting the
+// process could make some real-time process miss a deadline.
+int
+edfsetattr(uint64 runtime, uint64 deadline, uint64 period)
+{
+  struct proc *q, *p = myproc();
+  uint64 d, sum, max, now;
+
+  runtime /= 1000000000 / TIMEFREQ;
+  deadline /= 1000000000 / TIMEFREQ;
+  period /= 1000000000 / TIMEFREQ;
+
+  if(runtime != 0 && (runtime > deadline || deadline > period))
+    return -1;
+
+  acquire(&edf.lock);
+  if(runtime == 0){
+    acquire(&p->lock);
+    if(p->dl_runtime)
+      edf.ndeadline--;
+    p->dl_runtime = 0;
+    release(&p->lock);
+    release(&edf.lock);
+    return 0;
+  }
+
+  d = runtime * UNIT / deadline;
+  sum = max = d;
+  for(q = allproc; q; q = q->allnext){
+    if(q != p && q->dl_runtime){
+      sum += density(q);
+      if(density(q) > max)
+        max = density(q);
+    }
+  }
+  if(sum > ncpu * UNIT - (ncpu - 1) * max){
+    release(&edf.lock);
+    return -1;
+  }
+
+  // the first job starts now.
+  acquire(&p->lock);
+  if(p->dl_runtime == 0)
+    edf.ndeadline++;
+  now = r_time();
+  p->dl_runtime = runtime;
+  p->dl_deadline = deadline;
+  p->dl_period = period;
+  p->dl_release = now;
+  p->dl_abs = now + deadline;
+  p->dl_left = runtime;
+  p->dl_start = now;
+  release(&p->lock);
+  release(&edf.lock);
+  return 0;
+}
+
+// A real-time process has just become RUNNABLE.  Count it,
+// so that the scheduler knows to look again with edfpick().
+void
+edfready(void)
+{
+  __sync_fetch_and_add(&edf.nready, 1);
+}
+
+// Has a real-time process become RUNNABLE since *seen?
+// Updates *seen.  The scheduler calls edfpick() only then,
+// rather than scanning every process for every process.
+int
+edfchanged(uint64 *seen)
+{
+  uint64 n = edf.nready;
+
+  if(n == *seen)
+    return 0;
+  *seen = n;
+  // see the states of the processes counted.
+  __sync_synchronize();
+  return 1;
+}
+
+// Return the runnable real-time process with the earliest
+// deadline, locked, or 0 if there is none.
+struct proc*
+edfpick(void)
+{
+  struct proc *p, *best;
+
+  if(edf.ndeadline == 0)
+    return 0;
+  for(;;){
+    // look without locks, then make sure.
+    best = 0;
+    for(p = allproc; p; p = p->allnext){
+      if(p->dl_runtime && p->state == RUNNABLE &&
+         (best == 0 || p->dl_abs < best->dl_abs))
+        best = p;
+    }
+    if(best == 0)
+      return 0;
+    acquire(&best->lock);
+    if(best->dl_runtime && best->state == RUNNABLE)
+      return best;
+    release(&best->lock);
+  }
+}
+
+// The scheduler is about to run real-time process p.
+// Arrange a timer interrupt for when its budget runs out.
+// Caller must hold p->lock.
+void
+edfstart(struct proc *p)
+{
+  p->dl_start = r_time();
+  timerarm(p->dl_start + (p->dl_left ? p->dl_left : 1));
+}
+
+// Charge p for the time it has run since edfstart().
+// Caller must hold p->lock.
+void
+edfstop(struct proc *p)
+{
+  uint64 now = r_time();
+  uint64 used = now - p->dl_start;
+
+  p->dl_left = used < p->dl_left ? p->dl_left - used : 0;
+  p->dl_start = now;
+}
+
+// End the current process's job, and sleep until the
+// next period, when a new job starts.
+// Returns -1 if the process was killed.
+int
+edfyield(void)
+{
+  struct proc *p = myproc();
+  uint64 now, rel;
+
+  acquire(&p->lock);
+  if(p->dl_runtime == 0){
+    release(&p->lock);
+    yield();
+    return 0;
+  }
+  // skip periods that have passed entirely.
+  now = r_time();
+  p->dl_release += p->dl_period;
+  while(p->dl_release + p->dl_period <= now)
+    p->dl_release += p->dl_period;
+  p->dl_abs = p->dl_release + p->dl_deadline;
+  p->dl_left = p->dl_runtime;
+  rel = p->dl_release;
+  release(&p->lock);
+
+  return twsleep(rel);
+}
+
+// A timer interrupt or IPI in user space: throttle the
+// current process if it is real-time and has used up its
+// budget.  Called by usertrap() before it yields.
+void
+edftick(void)
+{
+  struct proc *p = myproc();
+  int out;
+
+  acquire(&p->lock);
+  if(p->dl_runtime == 0){
+    release(&p->lock);
+    return;
+  }
+  edfstop(p);
+  out = p->dl_left == 0;
+  release(&p->lock);
+
+  if(out)
+    edfyield();
+}
+
+// Real-time process p has just become runnable.  If no hart
+// is idle, make the one running the least urgent process
+// reschedule, so that p runs at once if it should.
+void
+edfpreempt(struct proc *p)
+{
+  struct proc *q;
+  uint64 latest = p->dl_abs;
+  int victim = -1;
+
+  for(int i = 0; i < NCPU; i++){
+    if((q = cpus[i].proc) == 0)
+      continue;
+    if(q->dl_runtime == 0){
+      victim = i;
+      break;
+    }
+    if(q->dl_abs > latest){
+      latest = q->dl_abs;
+      victim = i;
+    }
+  }
+  if(victim >= 0)
+    ipiresched(victim);
+}
@@ -0,0 +1,92 @@
+// Per-hart event rings, for the scheduler trace and the
+// profiler.
+//
+// Recording takes no locks: the hart that owns a ring, with
+// interrupts off, fills in the slot at the head and then
+// advances the head.  When the ring is full the oldest
+// records are overwritten.  A reader copies out what it has
+// not read yet, and drops what the writer overwrote as it
+// copied.  The slot being filled in is also that of the
+// record n before it, so a reader only ever takes the n-1
+// records behind the head.
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "evring.h"
+#include "defs.h"
+
+void
+evringinit(struct evring *r, void *buf, int size, int n)
+{
+  r->buf = buf;
+  r->size = size;
+  r->n = n;
+  r->head = r->tail = 0;
+}
+
+// The slot for the next record, to be filled in and then
+// published with evringpush().  Caller must be the ring's
+// hart, with interrupts off.
+void*
+evringslot(struct evring *r)
+{
+  return r->buf + (r->head % r->n) * r->size;
+}
+
+void
+evringpush(struct evring *r)
+{
+  // the record must be complete before a reader sees it.
+  __sync_synchronize();
+  r->head++;
+}
+
+// Forget the records not yet read.
+// Caller must hold the readers' lock.
+void
+evringskip(struct evring *r)
+{
+  r->tail = r->head;
+}
+
+// Copy up to n unread records to user address addr.
+// Returns the number copied, or -1.
+// Caller must hold the readers' lock.
+int
+evringdrain(struct evring *r, uint64 addr, int n)
+{
+  char buf[512];
+  uint64 head;
+  int m, got = 0;
+
+  while(got < n){
+    head = r->head;
+    __sync_synchronize();
+    if(head - r->tail > r->n - 1)
+      r->tail = head - (r->n - 1);
+    if(r->tail == head)
+      break;
+    m = head - r->tail;
+    if(m > sizeof(buf) / r->size)
+      m = sizeof(buf) / r->size;
+    if(m > n - got)
+      m = n - got;
+    for(int i = 0; i < m; i++)
+      memmove(buf + i*r->size, r->buf + ((r->tail + i) % r->n) * r->size,
+              r->size);
+
+    // drop any that the writer overwrote as we copied.
+    __sync_synchronize();
+    head = r->head;
+    if(head - r->tail >= r->n)
+      continue;
+    if(copyout(myproc()->pagetable, addr + got*r->size, buf, m*r->size) < 0)
+      return -1;
+    r->tail += m;
+    got += m;
+  }
+  return got;
+}
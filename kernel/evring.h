@@ -0,0 +1,11 @@
+// A ring of fixed-size records with one writer, a hart
+// with interrupts off, and readers serialized by a lock of
+// their own; see evring.c.
+
+struct evring {
+  char *buf;          // n records of size bytes each
+  int size;
+  int n;
+  uint64 head;        // records ever written
+  uint64 tail;        // records ever read, under the readers' lock
+};
@@ -21,6 +21,11 @@ exec(char *path, char **argv)
   pagetable_t pagetable = 0, oldpagetable;
   struct proc *p = myproc();
 
+  // the other threads would be left running in
+  // the old image.
+  if(p->leader != p || p->nthread > 0)
+    return -1;
+
   begin_op();
 
   if((ip = namei(path)) == 0){
@@ -114,6 +119,8 @@ exec(char *path, char **argv)
   p->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
+  p->ring = 0;
+  fpreset();
   proc_freepagetable(oldpagetable, oldsz);
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
@@ -0,0 +1,105 @@
+// Lazy switching of floating-point state.
+//
+// A process's floating-point registers and fcsr live in its
+// trapframe's f[] and fcsr, but trampoline.S never touches
+// them.  Instead, a process returns to user space with
+// sstatus.FS Off unless this hart's registers already hold
+// its state, so its first floating-point instruction traps
+// to fptrap(), which loads the state.  sched() saves the
+// registers only if the process has changed them (FS Dirty).
+// Processes that never use floating point pay nothing.
+//
+// Each hart remembers whose state its registers hold, in
+// c->fpowner; that process can run again on the same hart
+// without a restore.  p->fpcpu says which hart holds p's
+// latest state, in case p has since used another hart.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+void fpsave(uint64 *f);     // fpregs.S
+void fprestore(uint64 *f);
+
+static void
+fpstate(uint64 fs)
+{
+  w_sstatus((r_sstatus() & ~SSTATUS_FS) | fs);
+}
+
+// An illegal-instruction trap from user space.  If floating
+// point was off, load the process's state, so that the
+// instruction can be retried, and return 0.  Otherwise the
+// instruction is really illegal; return -1.
+int
+fptrap(void)
+{
+  struct proc *p = myproc();
+  struct trapframe *tf = p->trapframe;
+
+  if((r_sstatus() & SSTATUS_FS) != SSTATUS_FS_OFF)
+    return -1;
+
+  push_off();
+  fpstate(SSTATUS_FS_CLEAN);
+  if(!p->fpused){
+    memset(tf->f, 0, sizeof(tf->f));
+    tf->fcsr = 0;
+    p->fpused = 1;
+  }
+  fprestore(tf->f);
+  fpstate(SSTATUS_FS_CLEAN);
+  mycpu()->fpowner = p;
+  p->fpcpu = cpuid();
+  pop_off();
+  return 0;
+}
+
+// If the current process has changed its floating-point
+// registers, save them in its trapframe.  Called by sched()
+// before giving up the hart, and before copying the trapframe.
+void
+fpflush(void)
+{
+  push_off();
+  if((r_sstatus() & SSTATUS_FS) == SSTATUS_FS_DIRTY){
+    fpsave(myproc()->trapframe->f);
+    fpstate(SSTATUS_FS_CLEAN);
+  }
+  pop_off();
+}
+
+// Discard the current process's floating-point state,
+// for exec().
+void
+fpreset(void)
+{
+  struct proc *p = myproc();
+
+  push_off();
+  if(mycpu()->fpowner == p)
+    mycpu()->fpowner = 0;
+  p->fpused = 0;
+  p->fpcpu = -1;
+  pop_off();
+}
+
+// Return sstatus value x with FS set for a return to user
+// space: Off, unless this hart's registers hold the current
+// process's state.  Interrupts must be off.
+uint64
+fpuserstatus(uint64 x)
+{
+  struct proc *p = myproc();
+
+  if(mycpu()->fpowner == p && p->fpcpu == cpuid()){
+    if((x & SSTATUS_FS) == SSTATUS_FS_OFF)
+      x |= SSTATUS_FS_CLEAN;
+    return x;
+  }
+  return x & ~SSTATUS_FS;
+}
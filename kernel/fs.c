@@ -166,13 +166,20 @@ bfree(int dev, uint b)
 // entries. Since ip->ref indicates whether an entry is free,
 // and ip->dev and ip->inum indicate which i-node an entry
 // holds, one must hold itable.lock while using any of those fields.
+// It is a reader-writer lock: looking an inode up, or taking
+// another reference to it, needs only a read lock, with ip->ref
+// incremented atomically; allocating or dropping a reference
+// needs the write lock.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
+// It too is a reader-writer lock: ilockshared() lets several
+// processes read an inode at once, as pathname lookup does
+// with directories.
 
 struct {
-  struct spinlock lock;
+  struct rwspinlock lock;
   struct inode inode[NINODE];
 } itable;
 
@@ -181,7 +188,7 @@ iinit()
 {
   int i = 0;
   
-  initlock(&itable.lock, "itable");
+  initrwlock(&itable.lock, "itable");
   for(i = 0; i < NINODE; i++) {
     initsleeplock(&itable.inode[i].lock, "inode");
   }
@@ -244,14 +251,25 @@ iget(uint dev, uint inum)
 {
   struct inode *ip, *empty;
 
-  acquire(&itable.lock);
+  // Is the inode already in the table?  It usually is.
+  acquirerd(&itable.lock);
+  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
+    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
+      __sync_fetch_and_add(&ip->ref, 1);
+      releaserd(&itable.lock);
+      return ip;
+    }
+  }
+  releaserd(&itable.lock);
 
-  // Is the inode already in the table?
+  // Look again, since another process may have added it
+  // meanwhile.
+  acquirewr(&itable.lock);
   empty = 0;
   for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
     if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
       ip->ref++;
-      release(&itable.lock);
+      releasewr(&itable.lock);
       return ip;
     }
     if(empty == 0 && ip->ref == 0)    // Remember empty slot.
@@ -267,7 +285,7 @@ iget(uint dev, uint inum)
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
-  release(&itable.lock);
+  releasewr(&itable.lock);
 
   return ip;
 }
@@ -277,9 +295,9 @@ iget(uint dev, uint inum)
 struct inode*
 idup(struct inode *ip)
 {
-  acquire(&itable.lock);
-  ip->ref++;
-  release(&itable.lock);
+  acquirerd(&itable.lock);
+  __sync_fetch_and_add(&ip->ref, 1);
+  releaserd(&itable.lock);
   return ip;
 }
 
@@ -312,6 +330,24 @@ ilock(struct inode *ip)
   }
 }
 
+// Lock the given inode for reading only, sharing it
+// with other readers.
+void
+ilockshared(struct inode *ip)
+{
+  if(ip == 0 || ip->ref < 1)
+    panic("ilockshared");
+
+  // a reader can't read the inode in from disk, so have
+  // ilock() do it.  Once valid, ip stays valid while the
+  // caller holds its reference.
+  if(ip->valid == 0){
+    ilock(ip);
+    iunlock(ip);
+  }
+  acquiresleepshared(&ip->lock);
+}
+
 // Unlock the given inode.
 void
 iunlock(struct inode *ip)
@@ -322,6 +358,16 @@ iunlock(struct inode *ip)
   releasesleep(&ip->lock);
 }
 
+// Unlock an inode locked with ilockshared().
+void
+iunlockshared(struct inode *ip)
+{
+  if(ip == 0 || ip->ref < 1)
+    panic("iunlockshared");
+
+  releasesleepshared(&ip->lock);
+}
+
 // Drop a reference to an in-memory inode.
 // If that was the last reference, the inode table entry can
 // be recycled.
@@ -332,7 +378,7 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
-  acquire(&itable.lock);
+  acquirewr(&itable.lock);
 
   if(ip->ref == 1 && ip->valid && ip->nlink == 0){
     // inode has no links and no other references: truncate and free.
@@ -341,7 +387,7 @@ iput(struct inode *ip)
     // so this acquiresleep() won't block (or deadlock).
     acquiresleep(&ip->lock);
 
-    release(&itable.lock);
+    releasewr(&itable.lock);
 
     itrunc(ip);
     ip->type = 0;
@@ -350,11 +396,11 @@ iput(struct inode *ip)
 
     releasesleep(&ip->lock);
 
-    acquire(&itable.lock);
+    acquirewr(&itable.lock);
   }
 
   ip->ref--;
-  release(&itable.lock);
+  releasewr(&itable.lock);
 }
 
 // Common idiom: unlock, then put.
@@ -426,6 +472,7 @@ itrunc(struct inode *ip)
     for(j = 0; j < NINDIRECT; j++){
       if(a[j])
         bfree(ip->dev, a[j]);
+      cond_resched();
     }
     brelse(bp);
     bfree(ip->dev, ip->addrs[NDIRECT]);
@@ -472,6 +519,7 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
       break;
     }
     brelse(bp);
+    cond_resched();
   }
   return tot;
 }
@@ -503,6 +551,7 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
     }
     log_write(bp);
     brelse(bp);
+    cond_resched();
   }
 
   if(off > ip->size)
@@ -526,6 +575,8 @@ namecmp(const char *s, const char *t)
 
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
+// Caller must hold dp->lock, which may be shared: reading
+// within dp->size never allocates blocks.
 struct inode*
 dirlookup(struct inode *dp, char *name, uint *poff)
 {
@@ -629,28 +680,39 @@ static struct inode*
 namex(char *path, int nameiparent, char *name)
 {
   struct inode *ip, *next;
+  struct proc *p;
 
   if(*path == '/')
     ip = iget(ROOTDEV, ROOTINO);
-  else
-    ip = idup(myproc()->cwd);
+  else {
+    // the thread group shares the leader's cwd.
+    p = myproc()->leader;
+    acquire(&p->fdlock);
+    ip = idup(p->cwd);
+    release(&p->fdlock);
+  }
 
+  // directories are only read here, so several processes
+  // can look names up in one at once.
   while((path = skipelem(path, name)) != 0){
-    ilock(ip);
+    ilockshared(ip);
     if(ip->type != T_DIR){
-      iunlockput(ip);
+      iunlockshared(ip);
+      iput(ip);
       return 0;
     }
     if(nameiparent && *path == '\0'){
       // Stop one level early.
-      iunlock(ip);
+      iunlockshared(ip);
       return ip;
     }
     if((next = dirlookup(ip, name, 0)) == 0){
-      iunlockput(ip);
+      iunlockshared(ip);
+      iput(ip);
       return 0;
     }
-    iunlockput(ip);
+    iunlockshared(ip);
+    iput(ip);
     ip = next;
   }
   if(nameiparent){
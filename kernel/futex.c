@@ -0,0 +1,132 @@
+// Fast user-space mutexes.
+//
+// User code keeps its lock state in an ordinary 32-bit word,
+// and only calls futex() to sleep while the word has a value
+// it expects, or to wake sleepers after changing it.  Sleepers
+// are hashed by the physical address of the word, so threads
+// that map the same page meet in the same bucket.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "futex.h"
+#include "defs.h"
+
+#define NFUTEXHASH 61
+
+struct {
+  struct spinlock lock;
+  struct proc *head;  // sleepers, linked by p->fnext
+} futextab[NFUTEXHASH];
+
+void
+futexinit(void)
+{
+  for(int i = 0; i < NFUTEXHASH; i++)
+    initlock(&futextab[i].lock, "futex");
+}
+
+static int
+futexhash(uint64 pa)
+{
+  return (pa / sizeof(uint32)) % NFUTEXHASH;
+}
+
+// Caller must hold the bucket's lock.
+static void
+futexremove(struct proc **head, struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = head; *pp; pp = &(*pp)->fnext){
+    if(*pp == p){
+      *pp = p->fnext;
+      break;
+    }
+  }
+  p->fnext = 0;
+  p->futex = 0;
+}
+
+// Sleep until woken by FUTEX_WAKE on addr, if the word
+// at addr still holds val.  Returns -1 if it does not,
+// or if the process was killed.
+static int
+futexwait(uint64 pa, uint val)
+{
+  struct proc *p = myproc();
+  int h = futexhash(pa);
+
+  acquire(&futextab[h].lock);
+
+  // compare under the lock, so that a FUTEX_WAKE
+  // following a change to the word cannot be missed.
+  if(*(volatile uint32*)pa != val){
+    release(&futextab[h].lock);
+    return -1;
+  }
+
+  p->futex = pa;
+  p->fnext = futextab[h].head;
+  futextab[h].head = p;
+
+  // futexwake() clears p->futex when it wakes us.
+  while(p->futex != 0){
+    if(p->killed){
+      futexremove(&futextab[h].head, p);
+      release(&futextab[h].lock);
+      return -1;
+    }
+    sleep(&p->futex, &futextab[h].lock);
+  }
+  release(&futextab[h].lock);
+  return 0;
+}
+
+// Wake up to n sleepers on pa; return how many were woken.
+static int
+futexwake(uint64 pa, int n)
+{
+  struct proc *p, **pp;
+  int h = futexhash(pa);
+  int woken = 0;
+
+  acquire(&futextab[h].lock);
+  pp = &futextab[h].head;
+  while((p = *pp) != 0 && woken < n){
+    if(p->futex == pa){
+      *pp = p->fnext;
+      p->fnext = 0;
+      p->futex = 0;
+      wakeproc(p, &p->futex);
+      woken++;
+    } else {
+      pp = &p->fnext;
+    }
+  }
+  release(&futextab[h].lock);
+  return woken;
+}
+
+int
+futex(uint64 addr, int op, int val)
+{
+  uint64 pa;
+
+  if(addr % sizeof(uint32) != 0)
+    return -1;
+  if((pa = walkaddr(myproc()->pagetable, PGROUNDDOWN(addr))) == 0)
+    return -1;
+  pa += addr - PGROUNDDOWN(addr);
+
+  switch(op){
+  case FUTEX_WAIT:
+    return futexwait(pa, val);
+  case FUTEX_WAKE:
+    return futexwake(pa, val);
+  }
+  return -1;
+}
@@ -0,0 +1,170 @@
+// Inter-processor interrupts.
+//
+// A hart sends an IPI by queueing a message for the target
+// hart and then writing the target's CLINT MSIP register,
+// which raises a machine-mode software interrupt there.
+// timervec in kernelvec.S passes it on as a supervisor
+// software interrupt, and devintr() calls ipiintr() to act
+// on the queued messages.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define NIPIMSG 16
+
+#define IPI_RESCHED 1   // look for a process to run
+#define IPI_SFENCE  2   // flush the TLB
+
+struct ipimsg {
+  int type;     // IPI_RESCHED, IPI_SFENCE
+  int *ack;     // if non-zero, decremented once handled
+};
+
+struct {
+  struct spinlock lock;
+  struct ipimsg msg[NIPIMSG];
+  int n;
+} ipiq[NCPU];
+
+void
+ipiinit(void)
+{
+  for(int i = 0; i < NCPU; i++)
+    initlock(&ipiq[i].lock, "ipiq");
+}
+
+// Queue a message for hart cpu and interrupt it.
+// Returns -1 if its queue is full.
+static int
+ipisend(int cpu, int type, int *ack)
+{
+  acquire(&ipiq[cpu].lock);
+  if(type == IPI_RESCHED){
+    // one pending reschedule request is as good as many.
+    for(int i = 0; i < ipiq[cpu].n; i++){
+      if(ipiq[cpu].msg[i].type == IPI_RESCHED){
+        release(&ipiq[cpu].lock);
+        return 0;
+      }
+    }
+  }
+  if(ipiq[cpu].n == NIPIMSG){
+    release(&ipiq[cpu].lock);
+    return -1;
+  }
+  ipiq[cpu].msg[ipiq[cpu].n].type = type;
+  ipiq[cpu].msg[ipiq[cpu].n].ack = ack;
+  ipiq[cpu].n++;
+  release(&ipiq[cpu].lock);
+
+  *(uint32*)CLINT_MSIP(cpu) = 1;
+  return 0;
+}
+
+// Act on the messages queued for this hart.
+// Called by devintr() with interrupts off.
+void
+ipiintr(void)
+{
+  struct ipimsg msg[NIPIMSG];
+  int n;
+  int id = cpuid();
+
+  acquire(&ipiq[id].lock);
+  n = ipiq[id].n;
+  memmove(msg, ipiq[id].msg, n * sizeof(msg[0]));
+  ipiq[id].n = 0;
+  release(&ipiq[id].lock);
+
+  for(int i = 0; i < n; i++){
+    switch(msg[i].type){
+    case IPI_RESCHED:
+      // devintr() returning 2 is enough to make this
+      // hart yield, or rescan the process table if idle,
+      // unless the message arrived while we polled with
+      // preemption off; see tlbshootdown().
+      mycpu()->resched = 1;
+      break;
+    case IPI_SFENCE:
+      sfence_vma();
+      break;
+    }
+    if(msg[i].ack)
+      __sync_fetch_and_sub(msg[i].ack, 1);
+  }
+}
+
+// Ask an idle hart, if there is one, to look for a process
+// to run, since one has just become RUNNABLE.
+// Returns 1 if there was one.
+int
+ipikick(void)
+{
+  int kicked = 0;
+
+  push_off();
+  int id = cpuid();
+  for(int i = 0; i < NCPU; i++){
+    // claim the idle hart, so that the next wakeup
+    // picks a different one.
+    if(i != id && cpus[i].idle &&
+       __sync_bool_compare_and_swap(&cpus[i].idle, 1, 0)){
+      ipisend(i, IPI_RESCHED, 0);
+      kicked = 1;
+      break;
+    }
+  }
+  pop_off();
+  return kicked;
+}
+
+// Make hart cpu give up its process and reschedule.
+void
+ipiresched(int cpu)
+{
+  ipisend(cpu, IPI_RESCHED, 0);
+}
+
+// Make every other hart that may be using pagetable in user
+// mode flush its TLB, and wait until they all have.  If
+// pagetable is 0, flush every other hart, for changes to the
+// kernel page table.  Harts that later switch to pagetable
+// flush anyway, in userret.
+// Must be called with no spinlocks held, since the targets
+// may be spinning on one of them with interrupts off.
+void
+tlbshootdown(pagetable_t pagetable)
+{
+  int pending = 0;
+  struct proc *p;
+
+  push_off();
+  if(mycpu()->noff != 1)
+    panic("tlbshootdown");
+  int id = cpuid();
+  for(int i = 0; i < NCPU; i++){
+    if(i == id)
+      continue;
+    p = cpus[i].proc;
+    if(pagetable != 0 && (p == 0 || p->pagetable != pagetable))
+      continue;
+    __sync_fetch_and_add(&pending, 1);
+    while(ipisend(i, IPI_SFENCE, &pending) < 0){
+      // the target's queue is full; it may be waiting
+      // for us to handle our own messages.
+      ipiintr();
+    }
+  }
+
+  sfence_vma();
+  while(pending > 0){
+    // another hart may be waiting on us in turn.
+    ipiintr();
+  }
+  pop_off();
+}
@@ -26,7 +26,7 @@ struct {
 void
 kinit()
 {
-  initlock(&kmem.lock, "kmem");
+  initlockkind(&kmem.lock, "kmem", HOTLOCKKIND);
   freerange(end, (void*)PHYSTOP);
 }
 
@@ -0,0 +1,224 @@
+// Lock dependency checking, in kernels built with
+// make LOCKDEP=1.
+//
+// Locks are grouped into classes by name, and by whether they
+// are sleeplocks, so that, say, all the processes' locks form
+// one class.  Whenever a lock of class B is acquired while one
+// of class A is held, lockdep records that A comes before B.
+// If B was already known to come before A, directly or through
+// other classes, two harts taking them in opposite orders
+// could deadlock, and lockdep says so, with the chain of
+// acquisitions that put B first and a backtrace, even though
+// nothing went wrong this time.  It checks before the lock is
+// waited for, so a real deadlock is reported before it hangs.
+//
+// acquire() always turns interrupts off, so an interrupt
+// handler can't interrupt the holder of a lock it needs; the
+// interrupt hazard that is left, a sleeplock taken in an
+// interrupt handler, is reported too.
+//
+// Held spinlocks are tracked per hart, in c->held, and held
+// sleeplocks per process, in p->sleeplocks.  Sleeplocks held
+// shared, and nesting within one class, aren't checked.
+//
+// The order graph is a bitmap for each class, so taking locks
+// in an order seen before costs a few loads; only new orders
+// take graph.lock, and search for cycles.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define NCLASS 64
+
+// s->class is one more than the class's index, so that a
+// lock that is all zeroes, not yet initialized, has none.
+#define CLASS(s) ((s)->class - 1)
+
+struct {
+  // lockdep can't use acquire() on itself.
+  uint lock;
+
+  int nclass;
+  char *name[NCLASS];
+  int sleep[NCLASS];
+  int full;                      // ran out of classes?
+  uint64 after[NCLASS];          // bit b of after[a]: a before b
+  uint64 where[NCLASS][NCLASS];  // the first acquire of b after a
+} graph;
+
+static void
+graphlock(void)
+{
+  push_off();
+  while(__sync_lock_test_and_set(&graph.lock, 1) != 0)
+    ;
+  __sync_synchronize();
+}
+
+static void
+graphunlock(void)
+{
+  __sync_synchronize();
+  __sync_lock_release(&graph.lock);
+  pop_off();
+}
+
+// Find or make s's class.
+void
+lockdepclass(struct lockstat *s)
+{
+  int i, full = 0;
+
+  graphlock();
+  for(i = 0; i < graph.nclass; i++)
+    if(graph.sleep[i] == s->sleep && strncmp(graph.name[i], s->name, 32) == 0)
+      break;
+  if(i == graph.nclass){
+    if(graph.nclass < NCLASS){
+      graph.name[i] = s->name;
+      graph.sleep[i] = s->sleep;
+      graph.nclass++;
+    } else {
+      i = -1;
+      full = !graph.full;
+      graph.full = 1;
+    }
+  }
+  s->class = i + 1;
+  graphunlock();
+
+  if(full)
+    printf("lockdep: too many lock classes, not checking %s\n", s->name);
+}
+
+// Is there a chain of orders from class a to class b?  If so,
+// fills in prev[] so that prev[c] comes before c on it.
+// Caller must hold graph.lock.
+static int
+reaches(int a, int b, int *prev)
+{
+  uint64 seen = 1L << a, frontier = seen, next;
+
+  while(frontier){
+    next = 0;
+    for(int i = 0; i < graph.nclass; i++){
+      if((frontier & (1L << i)) == 0)
+        continue;
+      for(int j = 0; j < graph.nclass; j++){
+        if((graph.after[i] & (1L << j)) && !(seen & (1L << j))){
+          prev[j] = i;
+          next |= 1L << j;
+        }
+      }
+    }
+    if(next & (1L << b))
+      return 1;
+    seen |= next;
+    frontier = next;
+  }
+  return 0;
+}
+
+static void
+report(int a, int b, uint64 pc, int *prev)
+{
+  struct cpu *c = mycpu();
+
+  c->lockdepoff = 1;
+  printf("lockdep: possible deadlock: %s acquired at %p while holding %s,\n",
+         graph.name[b], pc, graph.name[a]);
+  printf("lockdep: but %s has been acquired before %s:\n",
+         graph.name[b], graph.name[a]);
+  for(int j = a; j != b; j = prev[j])
+    printf("lockdep:   %s then %s, at %p\n", graph.name[prev[j]],
+           graph.name[j], graph.where[prev[j]][j]);
+  backtrace();
+  c->lockdepoff = 0;
+}
+
+// A lock of class a is held while one of class b is
+// acquired at pc.  Interrupts must be off.
+static void
+order(int a, int b, uint64 pc)
+{
+  int prev[NCLASS], cycle = 0;
+
+  if(a < 0 || a == b || (graph.after[a] & (1L << b)))
+    return;
+  graphlock();
+  if((graph.after[a] & (1L << b)) == 0){
+    cycle = reaches(b, a, prev);
+    graph.after[a] |= 1L << b;
+    graph.where[a][b] = pc;
+  }
+  graphunlock();
+  if(cycle)
+    report(a, b, pc, prev);
+}
+
+// The lock with stats s is about to be acquired, by a
+// call at pc.  Check it against the locks already held.
+void
+lockdepacquire(struct lockstat *s, uint64 pc)
+{
+  struct cpu *c;
+  struct sleeplock *l;
+  int b = CLASS(s);
+
+  push_off();
+  c = mycpu();
+  if(c->lockdepoff || b < 0){
+    pop_off();
+    return;
+  }
+
+  if(s->sleep && c->inintr){
+    c->lockdepoff = 1;
+    printf("lockdep: sleeplock %s acquired in an interrupt handler at %p\n",
+           s->name, pc);
+    backtrace();
+    c->lockdepoff = 0;
+  }
+
+  for(int i = 0; i < c->nheld; i++)
+    order(CLASS(c->held[i]), b, pc);
+  if(c->proc && !c->inintr)
+    for(l = c->proc->sleeplocks; l; l = l->heldnext)
+      order(CLASS(&l->stat), b, pc);
+
+  if(!s->sleep){
+    if(c->nheld < NELEM(c->held))
+      c->held[c->nheld] = s;
+    c->nheld++;
+  }
+  pop_off();
+}
+
+// A spinlock with stats s has been released.
+// Interrupts must be off.
+void
+lockdeprelease(struct lockstat *s)
+{
+  struct cpu *c = mycpu();
+  int i;
+
+  if(c->nheld > NELEM(c->held)){
+    // too many to track; forget the extra ones.
+    c->nheld--;
+    return;
+  }
+  for(i = c->nheld - 1; i >= 0; i--){
+    if(c->held[i] == s){
+      for(; i < c->nheld - 1; i++)
+        c->held[i] = c->held[i+1];
+      c->nheld--;
+      return;
+    }
+  }
+}
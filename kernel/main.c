@@ -22,6 +22,15 @@ main()
     procinit();      // process table
     trapinit();      // trap vectors
     trapinithart();  // install kernel trap vector
+    twinit();        // timer wheel for sleeping processes
+    ipiinit();       // inter-processor interrupt queues
+    rcuinit();       // read-copy update
+    futexinit();     // futex wait table
+    edfinit();       // real-time scheduling class
+    traceinit();     // scheduler event tracing
+    profinit();      // sampling profiler
+    loadinit();      // load averages
+    statsinit();     // lock statistics device
     plicinit();      // set up interrupt controller
     plicinithart();  // ask PLIC for device interrupts
     binit();         // buffer cache
@@ -27,6 +27,7 @@
 
 // core local interruptor (CLINT), which contains the timer.
 #define CLINT 0x2000000L
+#define CLINT_MSIP(hartid) (CLINT + 4*(hartid))
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
 
@@ -62,6 +63,22 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   USYSCALL (struct usyscall, read-only)
+//   THREADFRAME(slot) (trapframes of the other threads)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+
+// the trapframes of a process's other threads, below its own.
+#define THREADFRAME(slot) (TRAPFRAME - (slot)*PGSIZE)
+
+// a page the kernel fills in, so that user code can find
+// these out without a system call; see user/ulib.c.
+#define USYSCALL (TRAPFRAME - NTHREAD*PGSIZE)
+
+struct usyscall {
+  int pid;                 // the process's pid, or 0 while it has threads
+  int pad;
+  uint64 tickinterval;     // timer cycles per tick; uptime() is time / this
+  uint64 timefreq;         // timer cycles per second
+};
@@ -1,6 +1,9 @@
-#define NPROC        64  // maximum number of processes
+#define MAXPROC    4096  // maximum number of processes; see procinit()
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
+#define NTHREAD      16  // maximum threads per process
+#define NPRIO        20  // process priorities; 0 is the most urgent
+#define PRIO_DEFAULT 10  // priority of init, inherited by fork
 #define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
@@ -9,5 +12,7 @@
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define FSSIZE       2000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
+#define TIMEFREQ     10000000  // timer cycles per second in qemu
+#define TICKINTERVAL 1000000   // timer cycles per tick; about 1/10th second
@@ -46,8 +46,10 @@ pipealloc(struct file **f0, struct file **f1)
   return 0;
 
  bad:
-  if(pi)
+  if(pi){
+    lockstatfree(&pi->lock.stat);
     kfree((char*)pi);
+  }
   if(*f0)
     fileclose(*f0);
   if(*f1)
@@ -68,6 +70,7 @@ pipeclose(struct pipe *pi, int writable)
   }
   if(pi->readopen == 0 && pi->writeopen == 0){
     release(&pi->lock);
+    lockstatfree(&pi->lock.stat);
     kfree((char*)pi);
   } else
     release(&pi->lock);
@@ -3,22 +3,76 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
+#include "pstat.h"
+#include "trace.h"
 #include "defs.h"
 
 struct cpu cpus[NCPU];
 
-struct proc proc[NPROC];
+// every struct proc ever allocated, linked by p->allnext.
+// procs are never freed, only recycled through freeprocs,
+// so a struct proc pointer stays a struct proc pointer, and
+// the list can be walked without a lock.
+struct proc *allproc;
+
+// procs not in use, linked by p->freenext: those that still
+// have a kernel stack mapped, and those that do not.  at most
+// NKSTACKCACHE unused stacks are kept; see kstacktrim().
+// proc_lock protects these, the count of procs allocated so
+// far, and the kernel page table's stack mappings.
+#define NKSTACKCACHE 8
+struct proc *freeprocs;
+int nfreeprocs;
+struct proc *bareprocs;
+int nproc;
+int nrcuprocs;            // freed, waiting for a grace period
+struct spinlock proc_lock;
+
+// the most processes there may be, set at boot by procinit()
+// from the size of memory, at most MAXPROC, or MAXPROCS if
+// the kernel was built with make MAXPROCS=n.  struct procs
+// are allocated as needed up to this limit and never freed.
+int maxproc;
+
+// the number of harts that have started scheduling.
+int ncpu;
+
+// the number of RUNNABLE normal processes at each effective
+// priority, so that topprio() need not look at every process.
+// changed atomically, under the process's lock.
+int nrunnable[NPRIO];
 
 struct proc *initproc;
 
+// pid_lock protects nextpid and changes to the pid hash
+// table, whose chains are linked by p->pidnext.  findproc()
+// walks the chains without it, under RCU: a freed proc goes
+// back on the free list, to be reused in another chain, only
+// after a grace period.
+#define NPIDHASH 64
 int nextpid = 1;
+struct proc *pidhash[NPIDHASH];
 struct spinlock pid_lock;
 
 extern void forkret(void);
 static void freeproc(struct proc *p);
+static int kstackalloc(struct proc *p);
+static int anyrunnable(void);
+static int topprio(void);
+static void makerunnable(struct proc *p);
+static void runproc(struct cpu *c, struct proc *p);
+static void readied(struct proc *p);
+static void priopreempt(struct proc *p);
+static void killthreads(struct proc *p);
+static void killlocked(struct proc *p);
+static int killpg(int pgid);
+static void procfreed(struct rcuhead *h);
 
 extern char trampoline[]; // trampoline.S
+extern char end[]; // first address after kernel; kernel.ld
+extern pagetable_t kernel_pagetable; // vm.c
 
 // helps ensure that wakeups of wait()ing
 // parents are not lost. helps obey the
@@ -26,33 +80,62 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
-// Allocate a page for each process's kernel stack.
-// Map it high in memory, followed by an invalid
-// guard page.
-void
-proc_mapstacks(pagetable_t kpgtbl) {
-  struct proc *p;
-  
-  for(p = proc; p < &proc[NPROC]; p++) {
-    char *pa = kalloc();
-    if(pa == 0)
-      panic("kalloc");
-    uint64 va = KSTACK((int) (p - proc));
-    kvmmap(kpgtbl, va, (uint64)pa, PGSIZE, PTE_R | PTE_W);
-  }
-}
+// serializes changes to the page tables and thread slots of
+// processes with threads, which may be running on other harts.
+// a sleep lock, since shrinking memory waits for a TLB shootdown.
+struct sleeplock threadlock;
+
+// pages of memory that a small process needs: kernel stack,
+// trapframe, page-table pages, and user text, data and stack.
+#define PROCPAGES 8
 
 // initialize the proc table at boot time.
 void
 procinit(void)
 {
-  struct proc *p;
-  
+  initlock(&proc_lock, "proc_lock");
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
-  for(p = proc; p < &proc[NPROC]; p++) {
-      initlock(&p->lock, "proc");
-      p->kstack = KSTACK((int) (p - proc));
+  initsleeplock(&threadlock, "threadlock");
+
+  // allow as many processes as memory could possibly hold.
+  maxproc = (PHYSTOP - PGROUNDUP((uint64)end)) / PGSIZE / PROCPAGES;
+  if(maxproc > MAXPROC)
+    maxproc = MAXPROC;
+#ifdef MAXPROCS
+  // a lower limit chosen when building the kernel.
+  if(MAXPROCS > 0 && maxproc > MAXPROCS)
+    maxproc = MAXPROCS;
+#endif
+}
+
+// Add a page's worth of new procs to bareprocs, up to
+// maxproc in all.  Each proc gets its own kernel stack
+// address, KSTACK(n), but no memory is mapped there
+// until the proc is used; see kstackalloc().
+// Caller must hold proc_lock.
+static void
+procgrow(void)
+{
+  struct proc *p;
+  char *mem;
+
+  if(nproc >= maxproc || (mem = kalloc()) == 0)
+    return;
+  memset(mem, 0, PGSIZE);
+  for(p = (struct proc*)mem; p + 1 <= (struct proc*)(mem + PGSIZE); p++){
+    if(nproc >= maxproc)
+      break;
+    initlock(&p->lock, "proc");
+    initlock(&p->fdlock, "fdlock");
+    p->kstack = KSTACK(nproc++);
+    p->freenext = bareprocs;
+    bareprocs = p;
+
+    // publish p only once it is initialized.
+    p->allnext = allproc;
+    __sync_synchronize();
+    allproc = p;
   }
 }
 
@@ -85,40 +168,109 @@ myproc(void) {
   return p;
 }
 
-int
-allocpid() {
-  int pid;
-  
+// Give p a new pid, and enter it in the pid hash table.
+static void
+allocpid(struct proc *p) {
+  struct proc **head;
+
   acquire(&pid_lock);
-  pid = nextpid;
+  p->pid = nextpid;
   nextpid = nextpid + 1;
+  head = &pidhash[p->pid % NPIDHASH];
+  p->pidnext = *head;
+  // findproc() may see p as soon as it is in the chain.
+  __sync_synchronize();
+  *head = p;
   release(&pid_lock);
+}
 
-  return pid;
+// Remove p from the pid hash table.  p->pidnext stays
+// as it is, for findproc()s that are looking at p.
+static void
+freepid(struct proc *p) {
+  struct proc **pp;
+
+  acquire(&pid_lock);
+  for(pp = &pidhash[p->pid % NPIDHASH]; *pp; pp = &(*pp)->pidnext){
+    if(*pp == p){
+      *pp = p->pidnext;
+      break;
+    }
+  }
+  release(&pid_lock);
 }
 
-// Look in the process table for an UNUSED proc.
+// Return the proc with the given pid, or 0 if none.
+// Takes no lock, so the proc may exit and be reused at
+// any time; the caller must check p->pid again while
+// holding p->lock.
+static struct proc*
+findproc(int pid) {
+  struct proc *p;
+
+  rcu_read_lock();
+  for(p = *(struct proc* volatile*)&pidhash[pid % NPIDHASH]; p;
+      p = *(struct proc* volatile*)&p->pidnext)
+    if(p->pid == pid)
+      break;
+  rcu_read_unlock();
+  return p;
+}
+
+// Take an UNUSED proc from the free list, allocating more
+// if it is empty.
 // If found, initialize state required to run in the kernel,
 // and return with p->lock held.
+// If leader is non-zero, the new proc is a thread sharing
+// leader's page table, and the caller maps its trapframe.
 // If there are no free procs, or a memory allocation fails, return 0.
 static struct proc*
-allocproc(void)
+allocproc(struct proc *leader)
 {
   struct proc *p;
-
-  for(p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if(p->state == UNUSED) {
-      goto found;
-    } else {
-      release(&p->lock);
+  int waited = 0;
+
+  // prefer a proc whose kernel stack is still mapped.
+again:
+  acquire(&proc_lock);
+  if(freeprocs){
+    p = freeprocs;
+    freeprocs = p->freenext;
+    nfreeprocs--;
+  } else {
+    if(bareprocs == 0)
+      procgrow();
+    if((p = bareprocs) == 0 || kstackalloc(p) < 0){
+      // procs freed lately are free after a grace period.
+      if(nrcuprocs > 0 && !waited && myproc()){
+        release(&proc_lock);
+        synchronize_rcu();
+        waited = 1;
+        goto again;
+      }
+      release(&proc_lock);
+      return 0;
     }
+    bareprocs = p->freenext;
   }
-  return 0;
+  release(&proc_lock);
 
-found:
-  p->pid = allocpid();
+  acquire(&p->lock);
+  if(p->state != UNUSED)
+    panic("allocproc");
+  allocpid(p);
+  traceevent(TR_FORK, p->pid, myproc() ? myproc()->pid : 0);
   p->state = USED;
+  p->leader = leader ? leader : p;
+  p->fpused = 0;
+  p->fpcpu = -1;
+  p->prio = p->eprio = PRIO_DEFAULT;
+  p->sleeplocks = 0;
+  p->ring = 0;
+  p->tracemask = 0;
+  p->utime = p->stime = p->wtime = 0;
+  p->cutime = p->cstime = p->cwtime = 0;
+  p->tstamp = r_time();
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -127,8 +279,24 @@ found:
     return 0;
   }
 
+  // and a USYSCALL page, unless p shares its leader's.
+  if(leader == 0){
+    if((p->usyscall = (struct usyscall *)kalloc()) == 0){
+      freeproc(p);
+      release(&p->lock);
+      return 0;
+    }
+    memset(p->usyscall, 0, PGSIZE);
+    p->usyscall->pid = p->pid;
+    p->usyscall->tickinterval = TICKINTERVAL;
+    p->usyscall->timefreq = TIMEFREQ;
+  }
+
   // An empty user page table.
-  p->pagetable = proc_pagetable(p);
+  if(leader)
+    p->pagetable = leader->pagetable;
+  else
+    p->pagetable = proc_pagetable(p);
   if(p->pagetable == 0){
     freeproc(p);
     release(&p->lock);
@@ -145,7 +313,8 @@ found:
 }
 
 // free a proc structure and the data hanging from it,
-// including user pages.
+// including user pages unless it is a thread, whose
+// trapframe the caller unmaps (see threadwait()).
 // p->lock must be held.
 static void
 freeproc(struct proc *p)
@@ -153,17 +322,111 @@ freeproc(struct proc *p)
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
-  if(p->pagetable)
+  if(p->usyscall)
+    kfree((void*)p->usyscall);
+  p->usyscall = 0;
+  if(p->pagetable && p->leader == p)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
   p->sz = 0;
+  if(p->pid)
+    freepid(p);
   p->pid = 0;
   p->parent = 0;
+  p->children = 0;
+  p->sibling = 0;
+  p->leader = 0;
+  p->tslot = 0;
+  p->nthread = 0;
+  p->tslots = 0;
+  p->ustack = 0;
   p->name[0] = 0;
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
   p->state = UNUSED;
+
+  // findproc() may still be looking at p, so it can't be
+  // reused until after a grace period.
+  acquire(&proc_lock);
+  nrcuprocs++;
+  release(&proc_lock);
+  call_rcu(&p->rcu, procfreed);
+}
+
+// Put a freed proc on the free list, after a grace period.
+// Its kernel stack stays mapped, for quick reuse; wait()
+// and join() call kstacktrim() to free those beyond
+// NKSTACKCACHE.
+static void
+procfreed(struct rcuhead *h)
+{
+  struct proc *p = (struct proc*)((char*)h - __builtin_offsetof(struct proc, rcu));
+
+  acquire(&proc_lock);
+  nrcuprocs--;
+  p->freenext = freeprocs;
+  freeprocs = p;
+  nfreeprocs++;
+  release(&proc_lock);
+}
+
+// Map a new kernel stack page at p->kstack, below an
+// unmapped guard page.
+// Caller must hold proc_lock, which serializes changes to
+// the kernel page table.
+static int
+kstackalloc(struct proc *p)
+{
+  char *pa;
+
+  if((pa = kalloc()) == 0)
+    return -1;
+  if(mappages(kernel_pagetable, p->kstack, PGSIZE, (uint64)pa, PTE_R | PTE_W) < 0){
+    kfree(pa);
+    return -1;
+  }
+  // no other hart has used this address since it was last
+  // unmapped and flushed, so only this one needs a flush.
+  sfence_vma();
+  return 0;
+}
+
+// Free the kernel stacks of unused procs beyond the first
+// NKSTACKCACHE, which are kept for quick reuse.
+// Unmapping a stack needs a TLB shootdown, so the caller
+// must hold no spinlocks, with interrupts on.
+void
+kstacktrim(void)
+{
+  struct proc *p;
+  pte_t *pte;
+  uint64 pa;
+
+  for(;;){
+    acquire(&proc_lock);
+    if(nfreeprocs <= NKSTACKCACHE){
+      release(&proc_lock);
+      return;
+    }
+    p = freeprocs;
+    freeprocs = p->freenext;
+    nfreeprocs--;
+    pte = walk(kernel_pagetable, p->kstack, 0);
+    pa = PTE2PA(*pte);
+    uvmunmap(kernel_pagetable, p->kstack, 1, 0);
+    release(&proc_lock);
+
+    // p is on neither free list, so nothing can map its
+    // stack again until every hart has forgotten it.
+    tlbshootdown(0);
+    kfree((void*)pa);
+
+    acquire(&proc_lock);
+    p->freenext = bareprocs;
+    bareprocs = p;
+    release(&proc_lock);
+  }
 }
 
 // Create a user page table for a given process,
@@ -196,6 +459,15 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
+  // map the USYSCALL page read-only for the user.
+  if(mappages(pagetable, USYSCALL, PGSIZE,
+              (uint64)(p->usyscall), PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+
   return pagetable;
 }
 
@@ -206,6 +478,7 @@ proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
   uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  uvmunmap(pagetable, USYSCALL, 1, 0);
   uvmfree(pagetable, sz);
 }
 
@@ -227,8 +500,9 @@ userinit(void)
 {
   struct proc *p;
 
-  p = allocproc();
+  p = allocproc(0);
   initproc = p;
+  p->pgid = p->pid;
   
   // allocate one user page and copy init's instructions
   // and data into it.
@@ -242,29 +516,54 @@ userinit(void)
   safestrcpy(p->name, "initcode", sizeof(p->name));
   p->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  makerunnable(p);
 
   release(&p->lock);
 }
 
 // Grow or shrink user memory by n bytes.
-// Return 0 on success, -1 on failure.
-int
+// Return the old size, read under threadlock so that
+// threads growing memory at once each get their own,
+// or -1 on failure.
+uint64
 growproc(int n)
 {
-  uint sz;
-  struct proc *p = myproc();
-
-  sz = p->sz;
+  uint sz, oldsz;
+  uint64 va;
+  struct proc *pp, *p = myproc();
+  // only this process itself could create a thread
+  // if it has none, so the check needs no lock.
+  int shared = p->leader->nthread > 0;
+
+  if(shared)
+    acquiresleep(&threadlock);
+  sz = oldsz = p->sz;
   if(n > 0){
     if((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0) {
+      if(shared)
+        releasesleep(&threadlock);
       return -1;
     }
   } else if(n < 0){
+    if(shared){
+      // other threads may still be using the pages on
+      // other harts; revoke user access and flush their
+      // TLBs before the pages can be reused.
+      for(va = PGROUNDUP(sz + n); va < PGROUNDUP(sz); va += PGSIZE)
+        uvmclear(p->pagetable, va);
+      tlbshootdown(p->pagetable);
+    }
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
-  p->sz = sz;
-  return 0;
+  if(shared){
+    for(pp = allproc; pp; pp = pp->allnext)
+      if(pp->leader == p->leader)
+        pp->sz = sz;
+    releasesleep(&threadlock);
+  } else {
+    p->sz = sz;
+  }
+  return oldsz;
 }
 
 // Create a new process, copying the parent.
@@ -272,12 +571,22 @@ growproc(int n)
 int
 fork(void)
 {
-  int i, pid;
+  int i, pid, shared;
   struct proc *np;
   struct proc *p = myproc();
+  struct proc *lp = p->leader;
+
+  // Keep other threads from changing the user memory until
+  // it is copied.  Take threadlock, which may sleep, before
+  // allocproc() returns holding np->lock, as clone() does.
+  shared = lp->nthread > 0;
+  if(shared)
+    acquiresleep(&threadlock);
 
   // Allocate process.
-  if((np = allocproc()) == 0){
+  if((np = allocproc(0)) == 0){
+    if(shared)
+      releasesleep(&threadlock);
     return -1;
   }
 
@@ -285,35 +594,57 @@ fork(void)
   if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
     freeproc(np);
     release(&np->lock);
+    if(shared)
+      releasesleep(&threadlock);
     return -1;
   }
   np->sz = p->sz;
 
-  // copy saved user registers.
+  // copy saved user registers, including any floating-point
+  // state still only in this hart's registers.
+  fpflush();
   *(np->trapframe) = *(p->trapframe);
+  np->fpused = p->fpused;
+  np->prio = np->eprio = p->prio;
+  np->ring = p->ring;
+  np->tracemask = p->tracemask;
 
   // Cause fork to return 0 in the child.
   np->trapframe->a0 = 0;
 
-  // increment reference counts on open file descriptors.
+  // increment reference counts on open file descriptors,
+  // which belong to the thread group leader.
+  acquire(&lp->fdlock);
   for(i = 0; i < NOFILE; i++)
-    if(p->ofile[i])
-      np->ofile[i] = filedup(p->ofile[i]);
-  np->cwd = idup(p->cwd);
+    if(lp->ofile[i])
+      np->ofile[i] = filedup(lp->ofile[i]);
+  np->cwd = idup(lp->cwd);
+  release(&lp->fdlock);
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
   pid = np->pid;
 
   release(&np->lock);
+  if(shared)
+    releasesleep(&threadlock);
 
+  // a child forked by a thread belongs to the whole process.
+  // a child forked while killpg() scans the table is
+  // killed along with its parent.
   acquire(&wait_lock);
-  np->parent = p;
+  np->parent = lp;
+  np->sibling = lp->children;
+  lp->children = np;
+  np->pgid = lp->pgid;
+  if(p->killed)
+    np->killed = 1;
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
+  makerunnable(np);
   release(&np->lock);
+  ipikick();
 
   return pid;
 }
@@ -325,17 +656,25 @@ reparent(struct proc *p)
 {
   struct proc *pp;
 
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    if(pp->parent == p){
-      pp->parent = initproc;
-      wakeup(initproc);
-    }
+  if(p->children == 0)
+    return;
+  for(pp = p->children; ; pp = pp->sibling){
+    pp->parent = initproc;
+    if(pp->sibling == 0)
+      break;
   }
+  pp->sibling = initproc->children;
+  initproc->children = p->children;
+  p->children = 0;
+  wakeup(initproc);
 }
 
 // Exit the current process.  Does not return.
 // An exited process remains in the zombie state
 // until its parent calls wait().
+// A thread other than the leader exits alone, and remains
+// a zombie until another thread calls join(); the leader
+// first kills and reaps the other threads.
 void
 exit(int status)
 {
@@ -344,6 +683,27 @@ exit(int status)
   if(p == initproc)
     panic("init exiting");
 
+  // give up any real-time reservation.
+  edfsetattr(0, 0, 0);
+  traceevent(TR_EXIT, p->pid, status);
+
+  if(p->leader != p){
+    acquire(&wait_lock);
+
+    // Another thread might be sleeping in join().
+    wakeup(p->leader);
+
+    acquire(&p->lock);
+    p->xstate = status;
+    p->state = ZOMBIE;
+    release(&wait_lock);
+    sched();
+    panic("zombie exit");
+  }
+
+  if(p->nthread > 0)
+    killthreads(p);
+
   // Close all open files.
   for(int fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd]){
@@ -380,40 +740,45 @@ exit(int status)
 
 // Wait for a child process to exit and return its pid.
 // Return -1 if this process has no children.
+// Any thread may wait for the process's children.
 int
 wait(uint64 addr)
 {
-  struct proc *np;
+  struct proc *np, **pp;
   int havekids, pid;
   struct proc *p = myproc();
+  struct proc *lp = p->leader;
 
   acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
+    // Scan through the children looking for exited ones.
     havekids = 0;
-    for(np = proc; np < &proc[NPROC]; np++){
-      if(np->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&np->lock);
-
-        havekids = 1;
-        if(np->state == ZOMBIE){
-          // Found one.
-          pid = np->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
-                                  sizeof(np->xstate)) < 0) {
-            release(&np->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(np);
+    for(pp = &lp->children; (np = *pp) != 0; pp = &np->sibling){
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&np->lock);
+
+      havekids = 1;
+      if(np->state == ZOMBIE){
+        // Found one.
+        pid = np->pid;
+        if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
+                                sizeof(np->xstate)) < 0) {
           release(&np->lock);
           release(&wait_lock);
-          return pid;
+          return -1;
         }
+        *pp = np->sibling;
+        lp->cutime += np->utime + np->cutime;
+        lp->cstime += np->stime + np->cstime;
+        lp->cwtime += np->wtime + np->cwtime;
+        freeproc(np);
         release(&np->lock);
+        release(&wait_lock);
+        kstacktrim();
+        return pid;
       }
+      release(&np->lock);
     }
 
     // No point waiting if we don't have any children.
@@ -423,8 +788,170 @@ wait(uint64 addr)
     }
     
     // Wait for a child to exit.
-    sleep(p, &wait_lock);  //DOC: wait-sleep
+    sleep(lp, &wait_lock);  //DOC: wait-sleep
+  }
+}
+
+// Create a new thread in the current process, which starts
+// at user address fn with arg in a0 and its stack pointer
+// at stack.  Return the new thread's id, which is also a pid.
+int
+clone(uint64 fn, uint64 arg, uint64 stack)
+{
+  int slot, tid;
+  struct proc *np;
+  struct proc *p = myproc();
+  struct proc *lp = p->leader;
+
+  acquiresleep(&threadlock);
+  for(slot = 1; slot < NTHREAD; slot++)
+    if((lp->tslots & (1 << slot)) == 0)
+      break;
+  // the leader is killed as it starts to exit; see killthreads().
+  if(slot == NTHREAD || lp->killed || (np = allocproc(lp)) == 0){
+    releasesleep(&threadlock);
+    return -1;
+  }
+
+  // map the new thread's trapframe, for trampoline.S.
+  if(mappages(lp->pagetable, THREADFRAME(slot), PGSIZE,
+              (uint64)(np->trapframe), PTE_R | PTE_W) < 0){
+    freeproc(np);
+    release(&np->lock);
+    releasesleep(&threadlock);
+    return -1;
   }
+  lp->tslots |= 1 << slot;
+  lp->nthread++;
+  // threads have pids of their own, so getpid() must ask.
+  lp->usyscall->pid = 0;
+  np->tslot = slot;
+  np->sz = p->sz;
+
+  fpflush();
+  *(np->trapframe) = *(p->trapframe);
+  np->fpused = p->fpused;
+  np->prio = np->eprio = p->prio;
+  np->tracemask = p->tracemask;
+  np->trapframe->epc = fn;
+  np->trapframe->a0 = arg;
+  np->trapframe->sp = stack;
+  np->ustack = stack;
+
+  safestrcpy(np->name, p->name, sizeof(p->name));
+
+  tid = np->pid;
+  makerunnable(np);
+  release(&np->lock);
+  releasesleep(&threadlock);
+  ipikick();
+
+  return tid;
+}
+
+// Wait for thread tid of the current process, or any thread
+// if tid is 0, to exit, free it, and return its id.
+// Sets *stack to the thread's stack from clone().
+// Return -1 if there is no such thread, or if killable and
+// the caller has been killed.
+static int
+threadwait(int tid, uint64 *stack, int killable)
+{
+  struct proc *np;
+  int found, slot;
+  struct proc *p = myproc();
+  struct proc *lp = p->leader;
+
+  acquire(&wait_lock);
+
+  for(;;){
+    found = 0;
+    for(np = allproc; np; np = np->allnext){
+      if(np == p || np == lp)
+        continue;
+      acquire(&np->lock);
+      if(np->leader == lp && (tid == 0 || np->pid == tid)){
+        found = 1;
+        if(np->state == ZOMBIE){
+          tid = np->pid;
+          slot = np->tslot;
+          *stack = np->ustack;
+          // the process's times include its threads'.
+          __sync_fetch_and_add(&lp->utime, np->utime);
+          __sync_fetch_and_add(&lp->stime, np->stime);
+          __sync_fetch_and_add(&lp->wtime, np->wtime);
+          freeproc(np);
+          release(&np->lock);
+          release(&wait_lock);
+
+          // the thread's trapframe is freed; unmap it
+          // before its slot can be reused.
+          acquiresleep(&threadlock);
+          uvmunmap(lp->pagetable, THREADFRAME(slot), 1, 0);
+          lp->tslots &= ~(1 << slot);
+          if(--lp->nthread == 0)
+            lp->usyscall->pid = lp->pid;
+          releasesleep(&threadlock);
+          kstacktrim();
+          return tid;
+        }
+      }
+      release(&np->lock);
+    }
+
+    if(!found || (killable && p->killed)){
+      release(&wait_lock);
+      return -1;
+    }
+
+    // Wait for a thread to exit.
+    sleep(lp, &wait_lock);
+  }
+}
+
+// Wait for a thread of the current process to exit; see
+// threadwait().  If addr is non-zero, copy the thread's
+// stack pointer from clone() there, so it can be freed.
+int
+join(int tid, uint64 addr)
+{
+  uint64 stack;
+  struct proc *p = myproc();
+
+  if((tid = threadwait(tid, &stack, 1)) < 0)
+    return -1;
+  if(addr != 0 && copyout(p->pagetable, addr, (char *)&stack,
+                          sizeof(stack)) < 0)
+    return -1;
+  return tid;
+}
+
+// Kill the other threads of leader p, which is exiting,
+// and wait for them to exit, since they share its memory
+// and files.
+static void
+killthreads(struct proc *p)
+{
+  struct proc *np;
+  uint64 stack;
+
+  // no new threads once killed is set; see clone().
+  acquiresleep(&threadlock);
+  acquire(&p->lock);
+  p->killed = 1;
+  release(&p->lock);
+  for(np = allproc; np; np = np->allnext){
+    if(np == p)
+      continue;
+    acquire(&np->lock);
+    if(np->leader == p)
+      killlocked(np);
+    release(&np->lock);
+  }
+  releasesleep(&threadlock);
+
+  while(threadwait(0, &stack, 0) >= 0)
+    ;
 }
 
 // Per-CPU process scheduler.
@@ -437,33 +964,161 @@ wait(uint64 addr)
 void
 scheduler(void)
 {
-  struct proc *p;
+  struct proc *p, *q;
   struct cpu *c = mycpu();
+  int found, run, top;
+  uint64 t, rtseen = 0;
   
   c->proc = 0;
+  __sync_fetch_and_add(&ncpu, 1);
   for(;;){
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
 
-    for(p = proc; p < &proc[NPROC]; p++) {
+    // a quiescent state for RCU, and a chance to run its
+    // callbacks.
+    rcuquiescent();
+    rcupoll();
+
+    found = 0;
+    top = topprio();
+    edfchanged(&rtseen);
+    for(p = allproc; p; p = p->allnext) {
+      // real-time processes come first, earliest deadline
+      // first.  Look for them at the start of the pass, and
+      // again only once another has become runnable.
+      if(p == allproc || edfchanged(&rtseen)){
+        while((q = edfpick()) != 0){
+          runproc(c, q);
+          release(&q->lock);
+          found = 1;
+        }
+      }
+
+      // then normal processes of the most urgent priority
+      // that is runnable, round robin; see setpriority().
       acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
+      run = p->state == RUNNABLE && p->dl_runtime == 0 && p->eprio <= top;
+      if(run) {
+        runproc(c, p);
+        found = 1;
       }
       release(&p->lock);
+      if(run)
+        top = topprio();
+    }
+
+    if(!found){
+      // Nothing to run.  Rather than spin, stop this hart's
+      // clock ticks and wait for an interrupt.  Look again
+      // with interrupts off, since an interrupt taken during
+      // the scan may have made a process runnable; any that
+      // arrives from now on stays pending and ends the wfi.
+      // Set idle first, so that a wakeup that misses the
+      // scan sends an IPI to end the wfi.
+      intr_off();
+      c->idle = 1;
+      __sync_synchronize();
+      if(!anyrunnable()){
+        timeridle(twnext());
+        t = r_time();
+        wfi();
+        c->idletime += r_time() - t;
+      }
+      c->idle = 0;
     }
   }
 }
 
+// Charge the time since p->tstamp to *t, one of p's
+// utime, stime or wtime.  Only p itself, or the scheduler
+// while p waits, uses p->tstamp.
+void
+charge(struct proc *p, uint64 *t)
+{
+  uint64 now = r_time();
+
+  __sync_fetch_and_add(t, now - p->tstamp);
+  p->tstamp = now;
+}
+
+// Switch to p, which is RUNNABLE, until it gives up the CPU.
+// It is the process's job to release its lock and then
+// reacquire it before jumping back to us.
+// Caller must hold p->lock.
+static void
+runproc(struct cpu *c, struct proc *p)
+{
+  charge(p, &p->wtime);
+  traceevent(TR_SWITCHIN, p->pid, 0);
+  c->resched = 0;
+  if(p->dl_runtime == 0)
+    __sync_fetch_and_sub(&nrunnable[p->eprio], 1);
+  p->state = RUNNING;
+  c->proc = p;
+  timerbusy();
+  if(p->dl_runtime)
+    edfstart(p);
+  swtch(&c->context, &p->context);
+
+  // Process is done running for now.
+  // It should have changed its p->state before coming back.
+  if(p->dl_runtime)
+    edfstop(p);
+  c->proc = 0;
+  c->rcuqs++;
+}
+
+// Make p RUNNABLE, counting it in nrunnable[].
+// Caller must hold p->lock.
+static void
+makerunnable(struct proc *p)
+{
+  if(p->dl_runtime == 0)
+    __sync_fetch_and_add(&nrunnable[p->eprio], 1);
+  p->state = RUNNABLE;
+}
+
+// Set p's effective priority, moving it between counts in
+// nrunnable[] if it is RUNNABLE.
+// Caller must hold p->lock.
+void
+seteprio(struct proc *p, int prio)
+{
+  if(p->state == RUNNABLE && p->dl_runtime == 0){
+    __sync_fetch_and_sub(&nrunnable[p->eprio], 1);
+    __sync_fetch_and_add(&nrunnable[prio], 1);
+  }
+  p->eprio = prio;
+}
+
+// The most urgent effective priority of any RUNNABLE normal
+// process, or NPRIO if there is none.  Looks without locks,
+// so the scheduler checks again before running a process.
+static int
+topprio(void)
+{
+  for(int i = 0; i < NPRIO; i++)
+    if(nrunnable[i] > 0)
+      return i;
+  return NPRIO;
+}
+
+// Is any process waiting for a CPU?
+static int
+anyrunnable(void)
+{
+  struct proc *p;
+  int found = 0;
+
+  for(p = allproc; p && !found; p = p->allnext) {
+    acquire(&p->lock);
+    found = (p->state == RUNNABLE);
+    release(&p->lock);
+  }
+  return found;
+}
+
 // Switch to scheduler.  Must hold only p->lock
 // and have changed proc->state. Saves and restores
 // intena because intena is a property of this
@@ -486,6 +1141,12 @@ sched(void)
   if(intr_get())
     panic("sched interruptible");
 
+  // save floating-point registers that p has changed,
+  // since another process may use them next.
+  fpflush();
+  charge(p, &p->stime);
+  traceevent(TR_SWITCHOUT, p->pid, p->state);
+
   intena = mycpu()->intena;
   swtch(&p->context, &mycpu()->context);
   mycpu()->intena = intena;
@@ -497,11 +1158,26 @@ yield(void)
 {
   struct proc *p = myproc();
   acquire(&p->lock);
-  p->state = RUNNABLE;
+  makerunnable(p);
+  if(p->dl_runtime)
+    edfready();
   sched();
   release(&p->lock);
 }
 
+// A preemption point for long loops in the kernel: give up
+// the CPU if a reschedule is pending, unless a spinlock is
+// held.  Kernel code with interrupts on is preempted by the
+// timer anyway, but a reschedule requested while this hart
+// could not act on it waits for the next preemption point.
+void
+cond_resched(void)
+{
+  // pop_off() is the preemption point.
+  push_off();
+  pop_off();
+}
+
 // A fork child's very first scheduling by scheduler()
 // will swtch to forkret.
 void
@@ -554,6 +1230,40 @@ sleep(void *chan, struct spinlock *lk)
   acquire(lk);
 }
 
+// p has just become RUNNABLE: find a hart to run it.
+static void
+readied(struct proc *p)
+{
+  if(p->dl_runtime)
+    edfready();
+  if(ipikick() != 0)
+    return;
+  if(p->dl_runtime)
+    edfpreempt(p);
+  else
+    priopreempt(p);
+}
+
+// Normal process p has just become RUNNABLE, and no hart is
+// idle.  Make the hart running the least urgent normal
+// process reschedule, if that is less urgent than p.
+static void
+priopreempt(struct proc *p)
+{
+  struct proc *q;
+  int worst = p->eprio, victim = -1;
+
+  for(int i = 0; i < NCPU; i++){
+    q = cpus[i].proc;
+    if(q && q->dl_runtime == 0 && q->eprio > worst){
+      worst = q->eprio;
+      victim = i;
+    }
+  }
+  if(victim >= 0)
+    ipiresched(victim);
+}
+
 // Wake up all processes sleeping on chan.
 // Must be called without any p->lock.
 void
@@ -561,39 +1271,224 @@ wakeup(void *chan)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
+  int woken;
+
+  for(p = allproc; p; p = p->allnext) {
     if(p != myproc()){
+      woken = 0;
       acquire(&p->lock);
       if(p->state == SLEEPING && p->chan == chan) {
-        p->state = RUNNABLE;
+        makerunnable(p);
+        p->tstamp = r_time();
+        traceevent(TR_WAKEUP, p->pid, 0);
+        woken = 1;
       }
       release(&p->lock);
+      if(woken)
+        readied(p);
     }
   }
 }
 
-// Kill the process with the given pid.
+// Wake up p if it is sleeping on chan.
+// Must be called without p->lock.
+void
+wakeproc(struct proc *p, void *chan)
+{
+  int woken = 0;
+
+  acquire(&p->lock);
+  if(p->state == SLEEPING && p->chan == chan) {
+    makerunnable(p);
+    p->tstamp = r_time();
+    traceevent(TR_WAKEUP, p->pid, 0);
+    woken = 1;
+  }
+  release(&p->lock);
+  if(woken)
+    readied(p);
+}
+
+// Mark p killed, and wake it if it is sleeping.
+// Caller must hold p->lock.
+static void
+killlocked(struct proc *p)
+{
+  p->killed = 1;
+  if(p->state == SLEEPING){
+    // Wake process from sleep().
+    makerunnable(p);
+    p->tstamp = r_time();
+    traceevent(TR_WAKEUP, p->pid, 0);
+    readied(p);
+  }
+}
+
+// Kill every process and thread in process group pgid,
+// in one pass over the process table.
+static int
+killpg(int pgid)
+{
+  struct proc *p;
+  int found = 0;
+
+  acquire(&wait_lock);
+  for(p = allproc; p; p = p->allnext){
+    acquire(&p->lock);
+    if(p->state != UNUSED && p->leader && p->leader->pgid == pgid &&
+       p != initproc){
+      killlocked(p);
+      found = 1;
+    }
+    release(&p->lock);
+  }
+  release(&wait_lock);
+  return found ? 0 : -1;
+}
+
+// Put the process with the given pid, which must be the
+// caller or one of its children, in process group pgid.
+// pid 0 means the caller, and pgid 0 means pgid = pid.
+int
+setpgid(int pid, int pgid)
+{
+  struct proc *p;
+  struct proc *lp = myproc()->leader;
+
+  if(pid == 0)
+    pid = lp->pid;
+  if(pgid == 0)
+    pgid = pid;
+  if(pid < 0 || pgid < 0)
+    return -1;
+
+  acquire(&wait_lock);
+  if(pid == lp->pid){
+    p = lp;
+  } else {
+    for(p = lp->children; p; p = p->sibling)
+      if(p->pid == pid)
+        break;
+  }
+  if(p == 0 || p->state == ZOMBIE){
+    release(&wait_lock);
+    return -1;
+  }
+  p->pgid = pgid;
+  release(&wait_lock);
+  return 0;
+}
+
+// Set the priority of the process or thread with the given
+// pid, or of the caller if pid is 0.  A process keeps any
+// more urgent priority it has inherited through sleeplocks
+// until it releases them.
+//
+// Priorities are strict and never age: a process runs only
+// while no more urgent one is runnable, so busy urgent
+// processes starve less urgent ones for as long as they stay
+// busy.  That is intended.  The one exception is
+// inheritance, so that a starved lock holder can't hold up a
+// more urgent waiter.
+int
+setpriority(int pid, int prio)
+{
+  struct proc *p;
+
+  if(prio < 0 || prio >= NPRIO)
+    return -1;
+  p = pid == 0 ? myproc() : findproc(pid);
+  if(p == 0)
+    return -1;
+  acquire(&p->lock);
+  if(p->state == UNUSED || (pid != 0 && p->pid != pid)){
+    release(&p->lock);
+    return -1;
+  }
+  p->prio = prio;
+  if(prio < p->eprio || p->sleeplocks == 0)
+    seteprio(p, prio);
+  release(&p->lock);
+  return 0;
+}
+
+// Return the priority of the process or thread with the
+// given pid, or of the caller if pid is 0.
+int
+getpriority(int pid)
+{
+  struct proc *p;
+  int prio = -1;
+
+  p = pid == 0 ? myproc() : findproc(pid);
+  if(p == 0)
+    return -1;
+  acquire(&p->lock);
+  if(p->state != UNUSED && (pid == 0 || p->pid == pid))
+    prio = p->prio;
+  release(&p->lock);
+  return prio;
+}
+
+// Return the process group of the process with the
+// given pid, or of the caller if pid is 0.
+int
+getpgid(int pid)
+{
+  struct proc *p;
+  int pgid = -1;
+
+  acquire(&wait_lock);
+  if(pid == 0){
+    pgid = myproc()->leader->pgid;
+  } else if((p = findproc(pid)) != 0){
+    acquire(&p->lock);
+    if(p->pid == pid && p->leader)
+      pgid = p->leader->pgid;
+    release(&p->lock);
+  }
+  release(&wait_lock);
+  return pgid;
+}
+
+// Kill the process with the given pid, and all its threads,
+// or just the thread with the given id, or if pid is
+// negative, process group -pid.
 // The victim won't exit until it tries to return
 // to user space (see usertrap() in trap.c).
 int
 kill(int pid)
 {
-  struct proc *p;
+  struct proc *p, *np;
+  int nthread;
 
-  for(p = proc; p < &proc[NPROC]; p++){
-    acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-      return 0;
-    }
+  if(pid < 0)
+    return killpg(-pid);
+  if((p = findproc(pid)) == 0)
+    return -1;
+  acquire(&p->lock);
+  if(p->pid != pid){
+    // exited since findproc().
     release(&p->lock);
+    return -1;
   }
-  return -1;
+  killlocked(p);
+  nthread = p->leader == p ? p->nthread : 0;
+  release(&p->lock);
+
+  // a thread created meanwhile sees its leader killed
+  // in clone().
+  if(nthread > 0){
+    for(np = allproc; np; np = np->allnext){
+      if(np == p)
+        continue;
+      acquire(&np->lock);
+      if(np->leader == p)
+        killlocked(np);
+      release(&np->lock);
+    }
+  }
+  return 0;
 }
 
 // Copy to either a user address, or kernel address,
@@ -626,6 +1521,88 @@ either_copyin(void *dst, int user_src, uint64 src, uint64 len)
   }
 }
 
+static uint64
+usec(uint64 t)
+{
+  return t / (TIMEFREQ / 1000000);
+}
+
+// Copy the CPU times of the current process, or of its
+// reaped children, to struct rusage at user address addr.
+int
+getrusage(int who, uint64 addr)
+{
+  struct rusage ru;
+  struct proc *np;
+  struct proc *p = myproc();
+  struct proc *lp = p->leader;
+
+  memset(&ru, 0, sizeof(ru));
+  if(who == RUSAGE_SELF){
+    charge(p, &p->stime);
+    for(np = allproc; np; np = np->allnext){
+      acquire(&np->lock);
+      if(np->leader == lp){
+        ru.utime += np->utime;
+        ru.stime += np->stime;
+        ru.wtime += np->wtime;
+      }
+      release(&np->lock);
+    }
+  } else if(who == RUSAGE_CHILDREN){
+    acquire(&wait_lock);
+    ru.utime = lp->cutime;
+    ru.stime = lp->cstime;
+    ru.wtime = lp->cwtime;
+    release(&wait_lock);
+  } else {
+    return -1;
+  }
+  ru.utime = usec(ru.utime);
+  ru.stime = usec(ru.stime);
+  ru.wtime = usec(ru.wtime);
+  return copyout(p->pagetable, addr, (char *)&ru, sizeof(ru));
+}
+
+// Copy a struct procinfo for each process and thread, up
+// to n of them, to the array at user address addr.
+// Return how many were copied.
+int
+procinfo(uint64 addr, int n)
+{
+  struct procinfo pi;
+  struct proc *p;
+  int i = 0;
+
+  acquire(&wait_lock);
+  for(p = allproc; p && i < n; p = p->allnext){
+    acquire(&p->lock);
+    if(p->state == UNUSED){
+      release(&p->lock);
+      continue;
+    }
+    pi.pid = p->pid;
+    pi.tgid = p->leader->pid;
+    pi.ppid = p->leader->parent ? p->leader->parent->pid : 0;
+    pi.state = p->state;
+    pi.sz = p->sz;
+    pi.ru.utime = usec(p->utime);
+    pi.ru.stime = usec(p->stime);
+    pi.ru.wtime = usec(p->wtime);
+    safestrcpy(pi.name, p->name, sizeof(pi.name));
+    release(&p->lock);
+
+    if(copyout(myproc()->pagetable, addr + i*sizeof(pi),
+               (char *)&pi, sizeof(pi)) < 0){
+      release(&wait_lock);
+      return -1;
+    }
+    i++;
+  }
+  release(&wait_lock);
+  return i;
+}
+
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
 // No lock to avoid wedging a stuck machine further.
@@ -643,7 +1620,7 @@ procdump(void)
   char *state;
 
   printf("\n");
-  for(p = proc; p < &proc[NPROC]; p++){
+  for(p = allproc; p; p = p->allnext){
     if(p->state == UNUSED)
       continue;
     if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
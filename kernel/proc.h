@@ -18,12 +18,29 @@ struct context {
   uint64 s11;
 };
 
+// A callback waiting for an RCU grace period; see rcu.c.
+struct rcuhead {
+  struct rcuhead *next;
+  void (*func)(struct rcuhead*);
+};
+
 // Per-CPU state.
 struct cpu {
   struct proc *proc;          // The process running on this cpu, or null.
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  int idle;                   // Waiting in wfi for work? See ipikick().
+  struct proc *fpowner;       // Whose state the FP registers hold, see fpu.c.
+  uint64 idletime;            // Timer cycles spent in wfi, see sysinfo.c.
+  int resched;                // Reschedule when next preemptible; see pop_off().
+  uint64 rcuqs;               // Quiescent states passed, see rcu.c.
+#ifdef LOCKDEP
+  struct lockstat *held[16];  // Spinlocks held, see lockdep.c.
+  int nheld;
+  int inintr;                 // In an interrupt handler?
+  int lockdepoff;             // Reporting; don't check.
+#endif
 };
 
 extern struct cpu cpus[NCPU];
@@ -78,6 +95,9 @@ struct trapframe {
   /* 264 */ uint64 t4;
   /* 272 */ uint64 t5;
   /* 280 */ uint64 t6;
+  // not touched by trampoline.S; see fpu.c.
+  /* 288 */ uint64 f[32];
+  /* 544 */ uint64 fcsr;
 };
 
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
@@ -92,16 +112,72 @@ struct proc {
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  int prio;                    // Priority, 0 most urgent; see setpriority()
+  int eprio;                   // Effective priority, boosted by waiters
 
-  // wait_lock must be held when using this:
+  // wait_lock must be held when using these:
   struct proc *parent;         // Parent process
+  struct proc *children;       // Children, linked by sibling
+  struct proc *sibling;        // Next child of parent
+  int pgid;                    // Leader: process group
+  uint64 cutime;               // Leader: times of reaped children,
+  uint64 cstime;               //   in timer cycles
+  uint64 cwtime;
+
+  // see allproc, freeprocs and pidhash in proc.c.
+  struct proc *allnext;        // All procs list; never changes
+  struct proc *freenext;       // Free list
+  struct proc *pidnext;        // Pid hash chain
+  struct rcuhead rcu;          // Waiting to go on the free list
+
+  // threadlock in proc.c must be held to change these.
+  // a process's threads share its leader's page table,
+  // open files and current directory.
+  struct proc *leader;         // Thread group leader, or this proc
+  int tslot;                   // Trapframe slot, see THREADFRAME
+  int nthread;                 // Leader: number of other threads
+  uint tslots;                 // Leader: bitmap of slots in use
+  uint64 ustack;               // Thread: user stack, for join()
+
+  // tw.lock in twheel.c must be held when using these:
+  uint64 deadline;             // If non-zero, wake at this time
+  struct proc *twnext;         // Timer wheel slot list
+  struct proc *twprev;
+
+  // the futex bucket lock in futex.c must be held when using these:
+  uint64 futex;                // If non-zero, futex() physical address waited on
+  struct proc *fnext;          // Futex bucket list
+
+  // edf.lock in edf.c must be held to change the first three;
+  // p->lock must be held when using the current job's state.
+  uint64 dl_runtime;           // If non-zero, real-time: budget per period
+  uint64 dl_deadline;          // Relative deadline of each job
+  uint64 dl_period;
+  uint64 dl_release;           // Start of the current period
+  uint64 dl_abs;               // Absolute deadline of the current job
+  uint64 dl_left;              // Budget left in the current job
+  uint64 dl_start;             // When we last started running
+
+  // CPU time accounting, in timer cycles; see charge() in proc.c.
+  // the counters only grow, with atomic adds.
+  uint64 tstamp;               // When the time since was last charged
+  uint64 utime;                // Time in user space
+  uint64 stime;                // Time in the kernel
+  uint64 wtime;                // Time RUNNABLE, waiting for a CPU
 
   // these are private to the process, so p->lock need not be held.
+  struct sleeplock *sleeplocks; // Held, linked by heldnext
+  int fpused;                  // Has used floating point; see fpu.c
+  int fpcpu;                   // Hart whose FP registers hold our state
+  uint64 ring;                 // User address of struct ring, or 0
+  uint64 tracemask;            // System calls to trace; see trace()
   uint64 kstack;               // Virtual address of kernel stack
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
+  struct usyscall *usyscall;   // Leader: page mapped at USYSCALL
   struct context context;      // swtch() here to run process
+  struct spinlock fdlock;      // Leader: protects ofile and cwd
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
@@ -0,0 +1,178 @@
+// Sampling profiler.
+//
+// profile(hz) makes every hart take a timer interrupt hz
+// times a second (see timerprof() in start.c), on top of its
+// others.  On each, profintr() records what was interrupted:
+// the pc, the return addresses found by following frame
+// pointers, and the process, in a sample on the hart's own
+// ring of NPROF (see evring.c), and profdrain() copies out
+// what hasn't been read.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "prof.h"
+#include "evring.h"
+#include "defs.h"
+
+#define NPROF 512      // samples per hart
+#define MAXHZ 10000
+
+struct {
+  struct spinlock lock;   // one reader at a time
+  uint64 interval;        // timer cycles between samples, or 0
+  uint64 seen[NCPU];      // timerprofnext() at each hart's last sample
+  struct evring ring[NCPU];
+  struct profsample s[NCPU][NPROF];
+} prof;
+
+extern char kernelvec[], timervec[];
+
+void
+profinit(void)
+{
+  initlock(&prof.lock, "prof");
+  for(int i = 0; i < NCPU; i++)
+    evringinit(&prof.ring[i], prof.s[i], sizeof(struct profsample), NPROF);
+}
+
+// Start sampling at hz samples a second on each hart,
+// or stop if hz is 0.
+int
+profstart(int hz)
+{
+  uint64 next;
+
+  if(hz < 0 || hz > MAXHZ)
+    return -1;
+  acquire(&prof.lock);
+  if(hz && prof.interval == 0){
+    // start afresh.
+    for(int i = 0; i < NCPU; i++)
+      evringskip(&prof.ring[i]);
+  }
+  prof.interval = hz ? TIMEFREQ / hz : 0;
+  next = timerprof(prof.interval);
+  for(int i = 0; i < NCPU; i++)
+    prof.seen[i] = next;
+  release(&prof.lock);
+  return 0;
+}
+
+// The frame pointer of the kernel code that was interrupted.
+// Walk up from here to kerneltrap()'s frame, whose return
+// address is in kernelvec, and take the one it saved.
+static uint64
+interruptedfp(void)
+{
+  uint64 fp = r_fp();
+  uint64 top = PGROUNDUP(fp);
+  uint64 ra;
+
+  while(fp < top && fp >= top - PGSIZE + 16){
+    ra = *(uint64*)(fp - 8);
+    fp = *(uint64*)(fp - 16);
+    if(ra >= (uint64)kernelvec && ra < (uint64)timervec)
+      return fp;
+  }
+  return 0;
+}
+
+// Follow user frame pointers from fp, adding return
+// addresses to s.  Reads through the page table, not with
+// copyin(), which might yield.
+static void
+userstack(struct proc *p, uint64 fp, struct profsample *s)
+{
+  uint64 pa, *frame;
+
+  while(s->depth < PROFDEPTH && fp != 0 && fp % 16 == 0){
+    if((pa = walkaddr(p->pagetable, PGROUNDDOWN(fp - 16))) == 0)
+      break;
+    frame = (uint64*)(pa + (fp - 16) % PGSIZE);
+    s->pc[s->depth++] = frame[1];
+    // callers' frames are higher up the stack.
+    if(frame[0] <= fp)
+      break;
+    fp = frame[0];
+  }
+}
+
+static void
+kernelstack(uint64 fp, struct profsample *s)
+{
+  uint64 top = PGROUNDUP(fp);
+  uint64 ra;
+
+  while(s->depth < PROFDEPTH && fp < top && fp >= top - PGSIZE + 16){
+    ra = *(uint64*)(fp - 8);
+    // usertrap()'s caller is user code.
+    if(ra < KERNBASE)
+      break;
+    s->pc[s->depth++] = ra;
+    fp = *(uint64*)(fp - 16);
+  }
+}
+
+// Called by devintr() on every timer interrupt and IPI, with
+// interrupts off.  If it was a profiler interrupt, record
+// what it interrupted.
+void
+profintr(void)
+{
+  struct profsample *s;
+  struct proc *p;
+  uint64 next;
+  int id;
+
+  if(prof.interval == 0)
+    return;
+  id = cpuid();
+  // timervec moves the profiler's deadline on only when it
+  // has passed.
+  next = timerprofnext();
+  if(next == prof.seen[id])
+    return;
+  prof.seen[id] = next;
+
+  s = evringslot(&prof.ring[id]);
+  p = myproc();
+  s->pid = p ? p->pid : 0;
+  s->cpu = id;
+  safestrcpy(s->name, p ? p->name : "scheduler", sizeof(s->name));
+  s->depth = 0;
+  if((r_sstatus() & SSTATUS_SPP) == 0){
+    // from user space, via usertrap().
+    s->user = 1;
+    s->pc[s->depth++] = p->trapframe->epc;
+    userstack(p, p->trapframe->s0, s);
+  } else {
+    s->user = 0;
+    s->pc[s->depth++] = r_sepc();
+    kernelstack(interruptedfp(), s);
+  }
+  evringpush(&prof.ring[id]);
+}
+
+// Copy up to n unread samples, hart by hart, to user
+// address addr.  Returns the number copied, or -1.
+int
+profdrain(uint64 addr, int n)
+{
+  int m, got = 0;
+
+  acquire(&prof.lock);
+  for(int i = 0; i < NCPU && got < n; i++){
+    if((m = evringdrain(&prof.ring[i], addr + got*sizeof(struct profsample),
+                        n - got)) < 0){
+      release(&prof.lock);
+      return -1;
+    }
+    got += m;
+  }
+  release(&prof.lock);
+  return got;
+}
@@ -0,0 +1,12 @@
+// Profiler samples; see prof.c.
+
+#define PROFDEPTH 8   // pcs recorded per sample
+
+struct profsample {
+  uint64 pc[PROFDEPTH];   // the interrupted pc, then return addresses
+  int depth;              // how many of pc[] are valid
+  int pid;                // 0 if the hart was idle
+  short cpu;
+  short user;             // 1 if interrupted in user space
+  char name[16];          // the process's name
+};
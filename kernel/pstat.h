@@ -0,0 +1,21 @@
+// Process accounting, for getrusage() and procinfo().
+// Times are in microseconds.
+
+#define RUSAGE_SELF     0   // the process, with all its threads
+#define RUSAGE_CHILDREN 1   // its children that have been waited for
+
+struct rusage {
+  uint64 utime;   // CPU time in user space
+  uint64 stime;   // CPU time in the kernel
+  uint64 wtime;   // time spent runnable, waiting for a CPU
+};
+
+struct procinfo {
+  int pid;
+  int ppid;
+  int tgid;       // pid of the thread group leader
+  int state;      // enum procstate in proc.h
+  uint64 sz;      // size of process memory (bytes)
+  struct rusage ru;
+  char name[16];
+};
@@ -0,0 +1,205 @@
+// Read-copy update, for data that is read without locks.
+//
+// Readers bracket their use of RCU-protected data with
+// rcu_read_lock() and rcu_read_unlock(), which only keep the
+// hart from switching to another process.  An updater, holding
+// whatever lock serializes updates, unlinks what it removes,
+// so that new readers can't find it, then waits for a grace
+// period with synchronize_rcu() or call_rcu() before freeing
+// or reusing it.  By the end of the grace period every hart
+// has passed through a quiescent state, where it can't be
+// inside a read-side critical section, so no reader that could
+// have seen the old data is still using it.
+//
+// The quiescent states are a pass through the scheduler, and
+// so every context switch; a trap from user space; and waiting
+// idle for an interrupt.  Each hart counts the ones it passes
+// in c->rcuqs.  A grace period is over once every other hart
+// is idle or has a count different from when it began.
+//
+// call_rcu() callbacks wait in two batches: next, for the next
+// grace period, and cur, for the one in progress.  Each pass
+// through the scheduler calls rcupoll(), which runs cur's
+// callbacks once their grace period is over, then starts one
+// for next.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+struct {
+  struct spinlock lock;
+  struct rcuhead *cur;      // waiting for the current grace period
+  struct rcuhead **curtail;
+  struct rcuhead *next;     // waiting for the next one
+  struct rcuhead **nexttail;
+  int busy;                 // is a grace period in progress?
+  uint64 gp;                // grace periods begun
+  uint64 snap[NCPU];        // each hart's rcuqs when it began
+} rcu;
+
+// synchronize_rcu()'s callback.
+struct rcuwait {
+  struct rcuhead head;
+  volatile int done;
+};
+
+void
+rcuinit(void)
+{
+  initlock(&rcu.lock, "rcu");
+  rcu.curtail = &rcu.cur;
+  rcu.nexttail = &rcu.next;
+}
+
+void
+rcu_read_lock(void)
+{
+  push_off();
+}
+
+void
+rcu_read_unlock(void)
+{
+  pop_off();
+}
+
+// This hart is at a quiescent state.
+void
+rcuquiescent(void)
+{
+  push_off();
+  mycpu()->rcuqs++;
+  pop_off();
+}
+
+// Start a grace period for the callbacks in cur.
+// Caller must hold rcu.lock.
+static void
+gpstart(void)
+{
+  for(int i = 0; i < ncpu; i++)
+    rcu.snap[i] = cpus[i].rcuqs;
+  rcu.busy = 1;
+  rcu.gp++;
+}
+
+// Has hart i passed a quiescent state since the grace
+// period began?  Caller must hold rcu.lock.
+static int
+passed(int i)
+{
+  return &cpus[i] == mycpu() || cpus[i].idle ||
+         cpus[i].rcuqs != rcu.snap[i];
+}
+
+// Is the grace period over?  The calling hart counts as
+// having passed, since it must be at a quiescent state.
+// Caller must hold rcu.lock.
+static int
+gpdone(void)
+{
+  __sync_synchronize();
+  for(int i = 0; i < ncpu; i++)
+    if(!passed(i))
+      return 0;
+  return 1;
+}
+
+// If the current grace period is over, run its callbacks,
+// and start one for any that are waiting.  The caller must
+// be at a quiescent state.
+void
+rcupoll(void)
+{
+  struct rcuhead *done = 0, *h;
+
+  if(rcu.cur == 0 && rcu.next == 0)
+    return;
+
+  acquire(&rcu.lock);
+  if(rcu.busy && gpdone()){
+    done = rcu.cur;
+    rcu.cur = 0;
+    rcu.curtail = &rcu.cur;
+    rcu.busy = 0;
+  }
+  if(!rcu.busy && rcu.next){
+    rcu.cur = rcu.next;
+    rcu.curtail = rcu.nexttail;
+    rcu.next = 0;
+    rcu.nexttail = &rcu.next;
+    gpstart();
+  }
+  release(&rcu.lock);
+
+  // in the order they were queued.
+  while((h = done) != 0){
+    done = h->next;
+    h->func(h);
+  }
+}
+
+// Call func(h) after a grace period.  func is called by
+// the scheduler, so it must not sleep.
+void
+call_rcu(struct rcuhead *h, void (*func)(struct rcuhead*))
+{
+  h->next = 0;
+  h->func = func;
+  acquire(&rcu.lock);
+  *rcu.nexttail = h;
+  rcu.nexttail = &h->next;
+  release(&rcu.lock);
+}
+
+static void
+rcuwaitdone(struct rcuhead *h)
+{
+  ((struct rcuwait*)h)->done = 1;
+}
+
+// Ask the harts that are holding up the grace period
+// to reschedule, which is a quiescent state.
+static void
+nudge(void)
+{
+  int lag[NCPU], n = 0;
+
+  acquire(&rcu.lock);
+  for(int i = 0; rcu.busy && i < ncpu; i++)
+    if(!passed(i))
+      lag[n++] = i;
+  release(&rcu.lock);
+  for(int i = 0; i < n; i++)
+    ipiresched(lag[i]);
+}
+
+// Wait for a grace period: until every reader that was
+// inside a read-side critical section when this was
+// called has left it.  Also runs the callbacks queued
+// before it.
+void
+synchronize_rcu(void)
+{
+  struct rcuwait w;
+  uint64 nudged = 0;
+
+  w.done = 0;
+  call_rcu(&w.head, rcuwaitdone);
+  for(;;){
+    rcupoll();
+    if(w.done)
+      break;
+    // once for each grace period.
+    if(rcu.busy && rcu.gp != nudged){
+      nudged = rcu.gp;
+      nudge();
+    }
+    yield();
+  }
+}
@@ -0,0 +1,40 @@
+// Batched system calls through a ring in user memory; see
+// ring_enter() in sysfile.c.
+//
+// The process fills in submission entries at sq[sqtail % NRING]
+// and advances sqtail, then calls ring_enter(n).  The kernel
+// carries out up to n of them in order, putting each result in
+// a completion entry at cq[cqtail % NRING].  The user owns
+// sqtail and cqhead, the kernel sqhead and cqtail.
+
+#define RING_READ   1   // fileread(fd, addr, n)
+#define RING_WRITE  2   // filewrite(fd, addr, n)
+#define RING_OPEN   3   // open(path at addr, n = omode)
+#define RING_CLOSE  4   // close(fd)
+#define RING_FSTAT  5   // fstat(fd, addr)
+
+#define NRING 64        // entries in each ring; a power of two
+
+struct ringsqe {
+  int op;         // RING_*
+  int fd;
+  uint64 addr;    // user buffer, path or struct stat
+  int n;          // byte count, or open mode
+  int pad;
+  uint64 data;    // copied to the completion
+};
+
+struct ringcqe {
+  uint64 data;    // from the submission
+  int res;        // what the system call would have returned
+  int pad;
+};
+
+struct ring {
+  uint sqhead;
+  uint sqtail;
+  uint cqhead;
+  uint cqtail;
+  struct ringsqe sq[NRING];
+  struct ringcqe cq[NRING];
+};
@@ -40,6 +40,11 @@ w_mepc(uint64 x)
 
 // Supervisor Status Register, sstatus
 
+#define SSTATUS_FS (3L << 13)  // Floating-point unit state:
+#define SSTATUS_FS_OFF (0L << 13)     //   trap on any use
+#define SSTATUS_FS_INITIAL (1L << 13)
+#define SSTATUS_FS_CLEAN (2L << 13)   //   unchanged since saved
+#define SSTATUS_FS_DIRTY (3L << 13)   //   changed since saved
 #define SSTATUS_SPP (1L << 8)  // Previous mode, 1=Supervisor, 0=User
 #define SSTATUS_SPIE (1L << 5) // Supervisor Previous Interrupt Enable
 #define SSTATUS_UPIE (1L << 4) // User Previous Interrupt Enable
@@ -260,6 +265,21 @@ r_mcounteren()
   return x;
 }
 
+// Supervisor-mode Counter-Enable
+static inline void 
+w_scounteren(uint64 x)
+{
+  asm volatile("csrw scounteren, %0" : : "r" (x));
+}
+
+static inline uint64
+r_scounteren()
+{
+  uint64 x;
+  asm volatile("csrr %0, scounteren" : "=r" (x) );
+  return x;
+}
+
 // machine-mode cycle counter
 static inline uint64
 r_time()
@@ -291,6 +311,14 @@ intr_get()
   return (x & SSTATUS_SIE) != 0;
 }
 
+// stall the hart until an interrupt is pending,
+// whether or not interrupts are enabled.
+static inline void
+wfi()
+{
+  asm volatile("wfi");
+}
+
 static inline uint64
 r_sp()
 {
@@ -309,6 +337,15 @@ r_tp()
   return x;
 }
 
+// the frame pointer, for backtrace().
+static inline uint64
+r_fp()
+{
+  uint64 x;
+  asm volatile("mv %0, s0" : "=r" (x) );
+  return x;
+}
+
 static inline void 
 w_tp(uint64 x)
 {
@@ -0,0 +1,112 @@
+// Reader-writer spin locks, for data that is mostly read:
+// any number of readers may hold one at once, or else a
+// single writer.  Sleeplocks can be shared the same way;
+// see acquiresleepshared().
+//
+// A waiting writer keeps new readers out, so that a steady
+// stream of readers cannot starve it.  So a reader must not
+// take a reader-writer lock it already holds: a writer could
+// arrive in between and leave both waiting for ever.
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "proc.h"
+
+void
+initrwlock(struct rwspinlock *lk, char *name)
+{
+  lk->name = name;
+  lk->cnt = 0;
+  lk->wwait = 0;
+  lk->cpu = 0;
+  lockstatinit(&lk->stat, name, 0);
+}
+
+// Readers update the statistics concurrently, so atomically.
+static void
+rwcount(struct lockstat *s, uint64 spins)
+{
+  __sync_fetch_and_add(&s->nacquire, 1);
+  if(spins){
+    __sync_fetch_and_add(&s->ncontended, 1);
+    __sync_fetch_and_add(&s->nspin, spins);
+  }
+}
+
+// Acquire the lock for reading.
+void
+acquirerd(struct rwspinlock *lk)
+{
+  uint64 spins = 0;
+  int c;
+
+  push_off();
+  if(lk->cpu == mycpu())
+    panic("acquirerd");
+#ifdef LOCKDEP
+  lockdepacquire(&lk->stat, (uint64)__builtin_return_address(0));
+#endif
+  for(;;){
+    c = *(volatile int*)&lk->cnt;
+    if(c >= 0 && *(volatile uint*)&lk->wwait == 0 &&
+       __sync_bool_compare_and_swap(&lk->cnt, c, c + 1))
+      break;
+    spins++;
+  }
+  __sync_synchronize();
+  rwcount(&lk->stat, spins);
+}
+
+void
+releaserd(struct rwspinlock *lk)
+{
+  if(lk->cnt <= 0)
+    panic("releaserd");
+  __sync_synchronize();
+  __sync_fetch_and_sub(&lk->cnt, 1);
+#ifdef LOCKDEP
+  lockdeprelease(&lk->stat);
+#endif
+  pop_off();
+}
+
+// Acquire the lock for writing.
+void
+acquirewr(struct rwspinlock *lk)
+{
+  uint64 spins = 0;
+
+  push_off();
+  if(lk->cpu == mycpu())
+    panic("acquirewr");
+#ifdef LOCKDEP
+  lockdepacquire(&lk->stat, (uint64)__builtin_return_address(0));
+#endif
+  __sync_fetch_and_add(&lk->wwait, 1);
+  while(!__sync_bool_compare_and_swap(&lk->cnt, 0, -1))
+    spins++;
+  __sync_fetch_and_sub(&lk->wwait, 1);
+  __sync_synchronize();
+  lk->cpu = mycpu();
+  rwcount(&lk->stat, spins);
+  lk->stat.tacquire = r_time();
+}
+
+void
+releasewr(struct rwspinlock *lk)
+{
+  if(lk->cnt != -1 || lk->cpu != mycpu())
+    panic("releasewr");
+  lk->stat.holdtime += r_time() - lk->stat.tacquire;
+  lk->cpu = 0;
+  __sync_synchronize();
+  __sync_lock_release(&lk->cnt);
+#ifdef LOCKDEP
+  lockdeprelease(&lk->stat);
+#endif
+  pop_off();
+}
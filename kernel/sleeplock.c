@@ -1,4 +1,23 @@
 // Sleeping locks
+//
+// With priority inheritance: a process that must wait for a
+// sleeplock lends its priority to the holder, so that the
+// holder is not kept from running, and from releasing the
+// lock, by processes of middling priority.  The holder's
+// effective priority falls back when it releases the lock,
+// to the best of its own and that of any waiters for the
+// other sleeplocks it still holds.  Only the holder is
+// boosted, not whatever the holder may be waiting for.
+//
+// A sleeplock can also be held shared, by any number of
+// readers at once; see acquiresleepshared().  Readers aren't
+// tracked, so a process waiting for them lends them nothing.
+//
+// Sleeplocks are adaptive: while the exclusive holder is
+// running on another hart, it is likely to let go soon, so a
+// waiter spins for a while rather than pay for two context
+// switches; it sleeps if the holder stops running, or keeps
+// the lock longer than SPINTIME.
 
 #include "types.h"
 #include "riscv.h"
@@ -9,37 +28,198 @@
 #include "proc.h"
 #include "sleeplock.h"
 
+#define SPINTIME (TIMEFREQ / 10000)   // 100us
+
 void
 initsleeplock(struct sleeplock *lk, char *name)
 {
   initlock(&lk->lk, "sleep lock");
   lk->name = name;
   lk->locked = 0;
+  lk->readers = 0;
+  lk->wwait = 0;
   lk->pid = 0;
+  lk->owner = 0;
+  lk->waitprio = NPRIO;
+  lk->heldnext = 0;
+  lockstatinit(&lk->stat, name, 1);
+}
+
+// Raise p's effective priority to at least prio.
+static void
+boost(struct proc *p, int prio)
+{
+  acquire(&p->lock);
+  if(p->eprio > prio)
+    seteprio(p, prio);
+  release(&p->lock);
+}
+
+// Recompute p's effective priority from its own priority and
+// the waiters for the sleeplocks it holds.  The waitprio of
+// locks other than the one being released is read without
+// its spinlock; a stale value is corrected by the next
+// waiter or release.  Caller must be p, holding p->lock.
+static void
+sleepunboost(struct proc *p)
+{
+  struct sleeplock *l;
+  int prio = p->prio;
+
+  for(l = p->sleeplocks; l; l = l->heldnext)
+    if(l->waitprio < prio)
+      prio = l->waitprio;
+  seteprio(p, prio);
+}
+
+// Waiter p lends its priority to lk's holder.
+// Caller must hold lk->lk.
+static void
+lend(struct sleeplock *lk, struct proc *p)
+{
+  // waiters register again after each release.
+  if(p->eprio < lk->waitprio)
+    lk->waitprio = p->eprio;
+  boost(lk->owner, p->eprio);
+}
+
+// Record an acquisition, after spins spins and sleeps sleeps.
+// Caller must hold lk->lk.
+static void
+count(struct sleeplock *lk, uint64 spins, uint64 sleeps)
+{
+  lk->stat.nacquire++;
+  if(spins || sleeps){
+    lk->stat.ncontended++;
+    lk->stat.nspin += spins;
+    lk->stat.nsleep += sleeps;
+  }
+}
+
+// If lk's exclusive holder is running on another hart, spin
+// until it lets go, stops running, or SPINTIME passes, adding
+// to *spins.  Returns 1 if lk may be free now, 0 if the caller
+// should sleep.  Caller must hold lk->lk, which is released
+// while spinning; the owner is type-stable, so it can be
+// looked at without it.
+static int
+spinowner(struct sleeplock *lk, uint64 *spins)
+{
+  struct proc *owner = lk->owner;
+  uint64 start;
+
+  if(owner == 0 || owner == myproc() || owner->state != RUNNING)
+    return 0;
+  release(&lk->lk);
+  start = r_time();
+  while(*(volatile uint*)&lk->locked &&
+        *(struct proc* volatile*)&lk->owner == owner &&
+        *(volatile enum procstate*)&owner->state == RUNNING){
+    if(r_time() - start > SPINTIME){
+      acquire(&lk->lk);
+      return 0;
+    }
+    (*spins)++;
+  }
+  acquire(&lk->lk);
+  return 1;
 }
 
 void
 acquiresleep(struct sleeplock *lk)
 {
+  struct proc *p = myproc();
+  uint64 spins = 0, sleeps = 0;
+
+#ifdef LOCKDEP
+  lockdepacquire(&lk->stat, (uint64)__builtin_return_address(0));
+#endif
   acquire(&lk->lk);
-  while (lk->locked) {
+  lk->wwait++;
+  while (lk->locked || lk->readers) {
+    if(lk->locked && spinowner(lk, &spins))
+      continue;
+    if(lk->locked)
+      lend(lk, p);
     sleep(lk, &lk->lk);
+    sleeps++;
   }
+  lk->wwait--;
+  count(lk, spins, sleeps);
+  lk->stat.tacquire = r_time();
   lk->locked = 1;
-  lk->pid = myproc()->pid;
+  lk->pid = p->pid;
+  lk->owner = p;
+  lk->heldnext = p->sleeplocks;
+  p->sleeplocks = lk;
   release(&lk->lk);
 }
 
 void
 releasesleep(struct sleeplock *lk)
 {
+  struct sleeplock **pp;
+  struct proc *p;
+
   acquire(&lk->lk);
+  lk->stat.holdtime += r_time() - lk->stat.tacquire;
+  p = lk->owner;
+  for(pp = &p->sleeplocks; *pp; pp = &(*pp)->heldnext){
+    if(*pp == lk){
+      *pp = lk->heldnext;
+      break;
+    }
+  }
   lk->locked = 0;
   lk->pid = 0;
+  lk->owner = 0;
+  lk->heldnext = 0;
+  lk->waitprio = NPRIO;
+  acquire(&p->lock);
+  sleepunboost(p);
+  release(&p->lock);
   wakeup(lk);
   release(&lk->lk);
 }
 
+// Hold lk shared with other readers: wait while it is held
+// exclusively, or a process is waiting to hold it so.  A
+// reader must not take a lock it already holds shared, since
+// an exclusive waiter in between would leave both waiting.
+void
+acquiresleepshared(struct sleeplock *lk)
+{
+  struct proc *p = myproc();
+  uint64 spins = 0, sleeps = 0;
+
+#ifdef LOCKDEP
+  lockdepacquire(&lk->stat, (uint64)__builtin_return_address(0));
+#endif
+  acquire(&lk->lk);
+  while (lk->locked || lk->wwait) {
+    if(lk->locked && spinowner(lk, &spins))
+      continue;
+    if(lk->locked)
+      lend(lk, p);
+    sleep(lk, &lk->lk);
+    sleeps++;
+  }
+  count(lk, spins, sleeps);
+  lk->readers++;
+  release(&lk->lk);
+}
+
+void
+releasesleepshared(struct sleeplock *lk)
+{
+  acquire(&lk->lk);
+  if(lk->readers < 1)
+    panic("releasesleepshared");
+  if(--lk->readers == 0)
+    wakeup(lk);
+  release(&lk->lk);
+}
+
 int
 holdingsleep(struct sleeplock *lk)
 {
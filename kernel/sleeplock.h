@@ -1,10 +1,19 @@
 // Long-term locks for processes
 struct sleeplock {
-  uint locked;       // Is the lock held?
+  uint locked;       // Is the lock held exclusively?
+  int readers;       // Processes holding it shared
+  int wwait;         // Exclusive waiters; new readers hold off
   struct spinlock lk; // spinlock protecting this sleep lock
   
   // For debugging:
   char *name;        // Name of lock.
   int pid;           // Process holding lock
+
+  // For priority inheritance; see sleeplock.c.
+  struct proc *owner;          // Process holding lock
+  int waitprio;                // Best priority of any waiter, or NPRIO
+  struct sleeplock *heldnext;  // Owner's other held sleeplocks
+
+  struct lockstat stat;        // Protected by lk
 };
 
@@ -1,4 +1,15 @@
 // Mutual exclusion spin locks.
+//
+// There are three kinds.  A test-and-set lock is one word that
+// every waiter hammers with atomic swaps; it is small, but the
+// cache line holding it bounces between the waiting harts, and
+// the one that gets it next is whichever happens to win.  A
+// ticket lock hands out numbered tickets and serves them in
+// order, so waiters get in first come first served, but they
+// still all spin on one word.  An MCS lock queues its waiters,
+// each spinning on its own node, so a release touches only the
+// next waiter's cache line.  Each hart has a few nodes, one for
+// every MCS lock it holds or is waiting for.
 
 #include "types.h"
 #include "param.h"
@@ -8,12 +19,45 @@
 #include "proc.h"
 #include "defs.h"
 
+#define NMCS 16      // MCS locks a hart can hold at once
+
+static struct mcsnode mcsnodes[NCPU][NMCS];
+
 void
 initlock(struct spinlock *lk, char *name)
+{
+  initlockkind(lk, name, LOCKKIND);
+}
+
+// Initialize a lock of a particular kind, SPIN_TAS,
+// SPIN_TICKET or SPIN_MCS.
+void
+initlockkind(struct spinlock *lk, char *name, int kind)
 {
   lk->name = name;
   lk->locked = 0;
+  lk->kind = kind;
+  lk->ticket = 0;
+  lk->serving = 0;
+  lk->tail = 0;
+  lk->node = 0;
   lk->cpu = 0;
+  lockstatinit(&lk->stat, name, 0);
+}
+
+// A free node of this hart's.  Interrupts must be off.
+static struct mcsnode*
+mcsget(void)
+{
+  struct mcsnode *n = mcsnodes[cpuid()];
+
+  for(int i = 0; i < NMCS; i++, n++){
+    if(!n->busy){
+      n->busy = 1;
+      return n;
+    }
+  }
+  panic("mcsget");
 }
 
 // Acquire the lock.
@@ -21,16 +65,49 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  struct mcsnode *n, *prev;
+  uint64 spins = 0;
+  uint t;
+
   push_off(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
-
-  // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
-  //   a5 = 1
-  //   s1 = &lk->locked
-  //   amoswap.w.aq a5, a5, (s1)
-  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+#ifdef LOCKDEP
+  lockdepacquire(&lk->stat, (uint64)__builtin_return_address(0));
+#endif
+
+  switch(lk->kind){
+  case SPIN_TICKET:
+    t = __sync_fetch_and_add(&lk->ticket, 1);
+    while(*(volatile uint*)&lk->serving != t)
+      spins++;
+    lk->locked = 1;
+    break;
+
+  case SPIN_MCS:
+    n = mcsget();
+    n->next = 0;
+    n->wait = 1;
+    // make n's fields visible before n is in the queue.
+    __sync_synchronize();
+    if((prev = __sync_lock_test_and_set(&lk->tail, n)) != 0){
+      *(struct mcsnode* volatile*)&prev->next = n;
+      while(*(volatile int*)&n->wait)
+        spins++;
+    }
+    lk->node = n;
+    lk->locked = 1;
+    break;
+
+  default:
+    // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
+    //   a5 = 1
+    //   s1 = &lk->locked
+    //   amoswap.w.aq a5, a5, (s1)
+    while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
+      spins++;
+    break;
+  }
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -40,15 +117,26 @@ acquire(struct spinlock *lk)
 
   // Record info about lock acquisition for holding() and debugging.
   lk->cpu = mycpu();
+
+  // the statistics are protected by the lock itself.
+  lk->stat.nacquire++;
+  if(spins){
+    lk->stat.ncontended++;
+    lk->stat.nspin += spins;
+  }
+  lk->stat.tacquire = r_time();
 }
 
 // Release the lock.
 void
 release(struct spinlock *lk)
 {
+  struct mcsnode *n;
+
   if(!holding(lk))
     panic("release");
 
+  lk->stat.holdtime += r_time() - lk->stat.tacquire;
   lk->cpu = 0;
 
   // Tell the C compiler and the CPU to not move loads or stores
@@ -59,14 +147,46 @@ release(struct spinlock *lk)
   // On RISC-V, this emits a fence instruction.
   __sync_synchronize();
 
-  // Release the lock, equivalent to lk->locked = 0.
-  // This code doesn't use a C assignment, since the C standard
-  // implies that an assignment might be implemented with
-  // multiple store instructions.
-  // On RISC-V, sync_lock_release turns into an atomic swap:
-  //   s1 = &lk->locked
-  //   amoswap.w zero, zero, (s1)
-  __sync_lock_release(&lk->locked);
+  switch(lk->kind){
+  case SPIN_TICKET:
+    // only the holder writes serving.
+    lk->locked = 0;
+    __sync_synchronize();
+    *(volatile uint*)&lk->serving = lk->serving + 1;
+    break;
+
+  case SPIN_MCS:
+    n = lk->node;
+    lk->locked = 0;
+    __sync_synchronize();
+    if(*(struct mcsnode* volatile*)&n->next == 0){
+      if(__sync_bool_compare_and_swap(&lk->tail, n, 0)){
+        n->busy = 0;
+        break;
+      }
+      // a waiter has joined the queue but not yet
+      // linked itself to n.
+      while(*(struct mcsnode* volatile*)&n->next == 0)
+        ;
+    }
+    __sync_lock_release(&n->next->wait);
+    n->busy = 0;
+    break;
+
+  default:
+    // Release the lock, equivalent to lk->locked = 0.
+    // This code doesn't use a C assignment, since the C standard
+    // implies that an assignment might be implemented with
+    // multiple store instructions.
+    // On RISC-V, sync_lock_release turns into an atomic swap:
+    //   s1 = &lk->locked
+    //   amoswap.w zero, zero, (s1)
+    __sync_lock_release(&lk->locked);
+    break;
+  }
+#ifdef LOCKDEP
+  lockdeprelease(&lk->stat);
+#endif
 
   pop_off();
 }
@@ -84,6 +204,11 @@ holding(struct spinlock *lk)
 // push_off/pop_off are like intr_off()/intr_on() except that they are matched:
 // it takes two pop_off()s to undo two push_off()s.  Also, if interrupts
 // are initially off, then push_off, pop_off leaves them off.
+//
+// noff doubles as the preempt count: a process can't be preempted
+// while it holds a spinlock.  A timer interrupt or IPI that asks for
+// a reschedule meanwhile sets c->resched, and the pop_off() that turns
+// interrupts back on yields, just as the interrupt would have.
 
 void
 push_off(void)
@@ -105,6 +230,13 @@ pop_off(void)
   if(c->noff < 1)
     panic("pop_off");
   c->noff -= 1;
-  if(c->noff == 0 && c->intena)
+  if(c->noff == 0 && c->intena){
+    if(c->resched && c->proc && c->proc->state == RUNNING){
+      c->resched = 0;
+      intr_on();
+      yield();
+      return;
+    }
     intr_on();
+  }
 }
@@ -1,9 +1,71 @@
+// Contention statistics, kept for every spinlock and
+// sleeplock; see stats.c.
+struct lockstat {
+  char *name;
+  int sleep;               // A sleeplock?
+  uint64 nacquire;         // Acquisitions
+  uint64 ncontended;       // Acquisitions that had to wait
+  uint64 nspin;            // Spin iterations
+  uint64 nsleep;           // Sleeps, for a sleeplock
+  uint64 holdtime;         // Timer cycles held, in all
+  uint64 tacquire;         // When last acquired
+  struct lockstat *next;   // All locks, see lockstatinit()
+  struct lockstat *prev;
+#ifdef LOCKDEP
+  int class;               // See lockdep.c
+#endif
+};
+
+// Kinds of spinlock; see spinlock.c.
+#define SPIN_TAS     0   // Test-and-set
+#define SPIN_TICKET  1   // Ticket lock, first come first served
+#define SPIN_MCS     2   // MCS queue lock
+
+// The kind of most locks, and of the hot ones (kmem, bcache
+// and tickslock).  make LOCKKIND=SPIN_TICKET, say, to change.
+#ifndef LOCKKIND
+#define LOCKKIND     SPIN_TAS
+#endif
+#ifndef HOTLOCKKIND
+#define HOTLOCKKIND  SPIN_MCS
+#endif
+
+// A waiter's place in the queue of an MCS lock.
+// Each has a cache line to itself to spin on.
+struct mcsnode {
+  struct mcsnode *next;    // Next waiter
+  int wait;                // Spin while set
+  int busy;                // In use by this hart
+} __attribute__((aligned(64)));
+
 // Mutual exclusion lock.
 struct spinlock {
   uint locked;       // Is the lock held?
+  int kind;          // SPIN_TAS, SPIN_TICKET or SPIN_MCS
+
+  // SPIN_TICKET
+  uint ticket;       // Next ticket to hand out
+  uint serving;      // Ticket of the holder
+
+  // SPIN_MCS
+  struct mcsnode *tail;    // Last in the queue, or 0
+  struct mcsnode *node;    // The holder's
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
+
+  struct lockstat stat;
 };
 
+// Reader-writer spin lock; see rwlock.c.
+struct rwspinlock {
+  int cnt;           // Readers holding the lock, or -1 for a writer
+  uint wwait;        // Writers waiting; new readers hold off
+
+  // For debugging:
+  char *name;        // Name of lock.
+  struct cpu *cpu;   // The cpu of the writer holding the lock.
+
+  struct lockstat stat;
+};
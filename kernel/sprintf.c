@@ -0,0 +1,107 @@
+//
+// formatted output into a buffer -- snprintf.
+//
+
+#include <stdarg.h>
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "riscv.h"
+#include "defs.h"
+
+static char digits[] = "0123456789abcdef";
+
+// Append c to buf, which holds sz bytes, leaving room
+// for the terminating 0.
+static void
+sputc(char *buf, int sz, int *off, char c)
+{
+  if(*off < sz - 1)
+    buf[(*off)++] = c;
+}
+
+static void
+sprintint(char *buf, int sz, int *off, uint64 x, int base, int neg)
+{
+  char tmp[24];
+  int i;
+
+  i = 0;
+  do {
+    tmp[i++] = digits[x % base];
+  } while((x /= base) != 0);
+
+  if(neg)
+    tmp[i++] = '-';
+
+  while(--i >= 0)
+    sputc(buf, sz, off, tmp[i]);
+}
+
+// Format into buf, which holds sz bytes, truncating if need
+// be.  Understands %d, %x, %p, %s, and %l for a uint64.
+// Returns the number of characters written, not counting
+// the terminating 0.
+int
+snprintf(char *buf, int sz, char *fmt, ...)
+{
+  va_list ap;
+  int i, c, x, off;
+  uint64 p;
+  char *s;
+
+  if(sz <= 0)
+    return 0;
+
+  off = 0;
+  va_start(ap, fmt);
+  for(i = 0; (c = fmt[i] & 0xff) != 0; i++){
+    if(c != '%'){
+      sputc(buf, sz, &off, c);
+      continue;
+    }
+    c = fmt[++i] & 0xff;
+    if(c == 0)
+      break;
+    switch(c){
+    case 'd':
+      x = va_arg(ap, int);
+      sprintint(buf, sz, &off, x < 0 ? -(uint64)x : x, 10, x < 0);
+      break;
+    case 'x':
+      sprintint(buf, sz, &off, va_arg(ap, uint), 16, 0);
+      break;
+    case 'l':
+      sprintint(buf, sz, &off, va_arg(ap, uint64), 10, 0);
+      break;
+    case 'p':
+      p = va_arg(ap, uint64);
+      sputc(buf, sz, &off, '0');
+      sputc(buf, sz, &off, 'x');
+      for(int j = 0; j < sizeof(uint64) * 2; j++, p <<= 4)
+        sputc(buf, sz, &off, digits[p >> (sizeof(uint64) * 8 - 4)]);
+      break;
+    case 's':
+      if((s = va_arg(ap, char*)) == 0)
+        s = "(null)";
+      for(; *s; s++)
+        sputc(buf, sz, &off, *s);
+      break;
+    case '%':
+      sputc(buf, sz, &off, '%');
+      break;
+    default:
+      // Print unknown % sequence to draw attention.
+      sputc(buf, sz, &off, '%');
+      sputc(buf, sz, &off, c);
+      break;
+    }
+  }
+  va_end(ap);
+  buf[off] = 0;
+  return off;
+}
@@ -11,7 +11,7 @@ void timerinit();
 __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
 
 // a scratch area per CPU for machine-mode timer interrupts.
-uint64 timer_scratch[NCPU][5];
+uint64 timer_scratch[NCPU][12];
 
 // assembly code in kernelvec.S for machine-mode timer interrupt.
 extern void timervec();
@@ -43,6 +43,9 @@ start()
   w_pmpaddr0(0x3fffffffffffffull);
   w_pmpcfg0(0xf);
 
+  // allow supervisor mode to read the time CSR.
+  w_mcounteren(r_mcounteren() | 2);
+
   // ask for clock interrupts.
   timerinit();
 
@@ -54,7 +57,7 @@ start()
   asm volatile("mret");
 }
 
-// set up to receive timer interrupts in machine mode,
+// set up to receive timer interrupts and IPIs in machine mode,
 // which arrive at timervec in kernelvec.S,
 // which turns them into software interrupts for
 // devintr() in trap.c.
@@ -65,16 +68,28 @@ timerinit()
   int id = r_mhartid();
 
   // ask the CLINT for a timer interrupt.
-  int interval = 1000000; // cycles; about 1/10th second in qemu.
+  int interval = TICKINTERVAL;
   *(uint64*)CLINT_MTIMECMP(id) = *(uint64*)CLINT_MTIME + interval;
 
   // prepare information in scratch[] for timervec.
-  // scratch[0..2] : space for timervec to save registers.
-  // scratch[3] : address of CLINT MTIMECMP register.
-  // scratch[4] : desired interval (in cycles) between timer interrupts.
+  // scratch[0..3] : space for timervec to save registers.
+  // scratch[4] : address of CLINT MTIMECMP register.
+  // scratch[5] : desired interval (in cycles) between timer interrupts.
+  // scratch[6] : time of the next periodic timer interrupt.
+  // scratch[7] : one-shot deadline from timerarm(), or 0.
+  // scratch[8] : address of CLINT MTIME register.
+  // scratch[9] : address of CLINT MSIP register, for IPIs.
+  // scratch[10] : interval between profiler interrupts, or 0.
+  // scratch[11] : time of the next profiler interrupt.
   uint64 *scratch = &timer_scratch[id][0];
-  scratch[3] = CLINT_MTIMECMP(id);
-  scratch[4] = interval;
+  scratch[4] = CLINT_MTIMECMP(id);
+  scratch[5] = interval;
+  scratch[6] = *(uint64*)CLINT_MTIMECMP(id);
+  scratch[7] = 0;
+  scratch[8] = CLINT_MTIME;
+  scratch[9] = CLINT_MSIP(id);
+  scratch[10] = 0;
+  scratch[11] = 0;
   w_mscratch((uint64)scratch);
 
   // set the machine-mode trap handler.
@@ -83,6 +98,98 @@ timerinit()
   // enable machine-mode interrupts.
   w_mstatus(r_mstatus() | MSTATUS_MIE);
 
-  // enable machine-mode timer interrupts.
-  w_mie(r_mie() | MIE_MTIE);
+  // enable machine-mode timer and software interrupts.
+  w_mie(r_mie() | MIE_MTIE | MIE_MSIE);
+}
+
+// the rest of this file runs in supervisor mode, with
+// interrupts off, to adjust this hart's timer interrupts.
+
+// reprogram MTIMECMP from scratch[] the way timervec does.
+// if timervec runs in the middle of this, anything stale
+// written here is earlier than it should be, and timervec
+// fixes it up when that early interrupt arrives.
+static void
+timerset(int id)
+{
+  uint64 *scratch = &timer_scratch[id][0];
+  uint64 next = scratch[6];
+
+  if(scratch[7] != 0 && scratch[7] < next)
+    next = scratch[7];
+  if(scratch[10] != 0 && scratch[11] < next)
+    next = scratch[11];
+  *(uint64*)CLINT_MTIMECMP(id) = next;
+}
+
+// ask for a one-shot timer interrupt on this hart at time
+// deadline, on top of the periodic ones, for sleepers whose
+// deadlines fall between ticks.
+void
+timerarm(uint64 deadline)
+{
+  int id = cpuid();
+  uint64 *scratch = &timer_scratch[id][0];
+
+  if(scratch[7] != 0 && scratch[7] <= deadline)
+    return;
+  scratch[7] = deadline;
+  timerset(id);
+}
+
+// stop the periodic timer interrupts on this hart, which
+// has nothing to run. if wake is non-zero, interrupt once
+// at that time, when the earliest sleeper is due.
+void
+timeridle(uint64 wake)
+{
+  int id = cpuid();
+  uint64 *scratch = &timer_scratch[id][0];
+
+  scratch[6] = ~0UL;
+  scratch[7] = wake;
+  timerset(id);
+}
+
+// restart the periodic timer interrupts on this hart
+// after timeridle(), since it is about to run a process.
+void
+timerbusy(void)
+{
+  int id = cpuid();
+  uint64 *scratch = &timer_scratch[id][0];
+
+  if(scratch[6] != ~0UL)
+    return;
+  scratch[6] = r_time() + scratch[5];
+  timerset(id);
+}
+
+// interrupt every hart each interval cycles for the
+// profiler, on top of its other timer interrupts, or stop
+// if interval is 0.  the other harts start or stop at their
+// next timer interrupt; an idle one, with none due, doesn't
+// start until it has something to run.  returns the time
+// of the first profiler interrupt.
+uint64
+timerprof(uint64 interval)
+{
+  uint64 next = r_time() + interval;
+
+  for(int i = 0; i < NCPU; i++){
+    // timervec must not see the interval before the deadline.
+    timer_scratch[i][11] = next;
+    __sync_synchronize();
+    timer_scratch[i][10] = interval;
+  }
+  timerset(cpuid());
+  return next;
+}
+
+// the time of this hart's next profiler interrupt, which
+// timervec moves on each time one arrives.
+uint64
+timerprofnext(void)
+{
+  return timer_scratch[cpuid()][11];
 }
@@ -0,0 +1,166 @@
+// Lock contention statistics, and the statistics device.
+//
+// initlock() and initsleeplock() put every lock's struct
+// lockstat on a list.  Reading the statistics device reports
+// them, one line per lock name, adding up locks that share a
+// name, such as the one in each process:
+//
+//   kind nacquire ncontended nspin nsleep holdtime name
+//
+// separated by tabs, where kind is spin or sleep.  A sleeplock
+// may spin before it sleeps; see acquiresleep().  holdtime is
+// in timer cycles.  A reader sees a snapshot taken
+// by its first read.  Writing to the device zeroes the counters.
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "riscv.h"
+#include "defs.h"
+
+#define BUFSZ   8192
+#define NNAME   64     // distinct lock names reported
+
+struct {
+  // stats.lock is all zeroes until statsinit(), which is
+  // enough for acquire(), so locks initialized earlier in
+  // main() can register themselves.
+  struct spinlock lock;
+  struct lockstat *list;  // every registered lock
+
+  // the snapshot being read, and its per-name totals.
+  char buf[BUFSZ];
+  int sz;
+  int off;
+  struct lockstat sum[NNAME];
+} stats;
+
+// Add s, for a lock called name, to the list.
+void
+lockstatinit(struct lockstat *s, char *name, int sleep)
+{
+  memset(s, 0, sizeof(*s));
+  s->name = name;
+  s->sleep = sleep;
+#ifdef LOCKDEP
+  lockdepclass(s);
+#endif
+
+  acquire(&stats.lock);
+  s->next = stats.list;
+  if(stats.list)
+    stats.list->prev = s;
+  stats.list = s;
+  release(&stats.lock);
+}
+
+// Take s off the list, before its lock is freed.
+void
+lockstatfree(struct lockstat *s)
+{
+  acquire(&stats.lock);
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    stats.list = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+  s->next = s->prev = 0;
+  release(&stats.lock);
+}
+
+// Format the totals for each lock name into stats.buf.
+// The counters are read without their locks, so a line
+// may be slightly out of date.
+// Caller must hold stats.lock.
+static int
+snapshot(void)
+{
+  struct lockstat *s, *t;
+  int i, n = 0, off = 0;
+
+  for(s = stats.list; s; s = s->next){
+    for(i = 0; i < n; i++){
+      t = &stats.sum[i];
+      if(t->sleep == s->sleep && strncmp(t->name, s->name, 32) == 0)
+        break;
+    }
+    if(i == n){
+      if(n == NNAME)
+        continue;
+      t = &stats.sum[n++];
+      memset(t, 0, sizeof(*t));
+      t->name = s->name;
+      t->sleep = s->sleep;
+    }
+    t->nacquire += s->nacquire;
+    t->ncontended += s->ncontended;
+    t->nspin += s->nspin;
+    t->nsleep += s->nsleep;
+    t->holdtime += s->holdtime;
+  }
+
+  for(i = 0; i < n; i++){
+    t = &stats.sum[i];
+    if(t->nacquire == 0)
+      continue;
+    off += snprintf(stats.buf + off, BUFSZ - off, "%s\t%l\t%l\t%l\t%l\t%l\t%s\n",
+                    t->sleep ? "sleep" : "spin", t->nacquire, t->ncontended,
+                    t->nspin, t->nsleep, t->holdtime, t->name);
+  }
+  return off;
+}
+
+// Read from the snapshot, taking one on the first read;
+// reading to the end lets the next reader take a fresh one.
+static int
+statsread(int user_dst, uint64 dst, int n)
+{
+  int m;
+
+  acquire(&stats.lock);
+  if(stats.sz == 0)
+    stats.sz = snapshot();
+  m = stats.sz - stats.off;
+  if(m > n)
+    m = n;
+  if(either_copyout(user_dst, dst, stats.buf + stats.off, m) == -1){
+    release(&stats.lock);
+    return -1;
+  }
+  stats.off += m;
+  if(m == 0)
+    stats.sz = stats.off = 0;
+  release(&stats.lock);
+  return m;
+}
+
+// Zero every lock's counters.
+static int
+statswrite(int user_src, uint64 src, int n)
+{
+  struct lockstat *s;
+
+  acquire(&stats.lock);
+  for(s = stats.list; s; s = s->next){
+    s->nacquire = 0;
+    s->ncontended = 0;
+    s->nspin = 0;
+    s->nsleep = 0;
+    s->holdtime = 0;
+  }
+  release(&stats.lock);
+  return n;
+}
+
+void
+statsinit(void)
+{
+  initlock(&stats.lock, "stats");
+
+  devsw[STATS].read = statsread;
+  devsw[STATS].write = statswrite;
+}
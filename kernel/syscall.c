@@ -104,6 +104,26 @@ extern uint64 sys_unlink(void);
 extern uint64 sys_wait(void);
 extern uint64 sys_write(void);
 extern uint64 sys_uptime(void);
+extern uint64 sys_nanosleep(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_join(void);
+extern uint64 sys_futex(void);
+extern uint64 sys_sched_setattr(void);
+extern uint64 sys_sched_yield(void);
+extern uint64 sys_getrusage(void);
+extern uint64 sys_procinfo(void);
+extern uint64 sys_tracedrain(void);
+extern uint64 sys_sysinfo(void);
+extern uint64 sys_setpgid(void);
+extern uint64 sys_getpgid(void);
+extern uint64 sys_tcsetpgrp(void);
+extern uint64 sys_setpriority(void);
+extern uint64 sys_getpriority(void);
+extern uint64 sys_ring_setup(void);
+extern uint64 sys_ring_enter(void);
+extern uint64 sys_trace(void);
+extern uint64 sys_profile(void);
+extern uint64 sys_profdrain(void);
 
 static uint64 (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -127,6 +147,26 @@ static uint64 (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_nanosleep] sys_nanosleep,
+[SYS_clone]   sys_clone,
+[SYS_join]    sys_join,
+[SYS_futex]   sys_futex,
+[SYS_sched_setattr] sys_sched_setattr,
+[SYS_sched_yield] sys_sched_yield,
+[SYS_getrusage] sys_getrusage,
+[SYS_procinfo] sys_procinfo,
+[SYS_tracedrain] sys_tracedrain,
+[SYS_sysinfo] sys_sysinfo,
+[SYS_setpgid] sys_setpgid,
+[SYS_getpgid] sys_getpgid,
+[SYS_tcsetpgrp] sys_tcsetpgrp,
+[SYS_setpriority] sys_setpriority,
+[SYS_getpriority] sys_getpriority,
+[SYS_ring_setup] sys_ring_setup,
+[SYS_ring_enter] sys_ring_enter,
+[SYS_trace]   sys_trace,
+[SYS_profile] sys_profile,
+[SYS_profdrain] sys_profdrain,
 };
 
 void
@@ -137,7 +177,14 @@ syscall(void)
 
   num = p->trapframe->a7;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
-    p->trapframe->a0 = syscalls[num]();
+    if(p->tracemask & (1L << num)){
+      uint64 a[3] = { p->trapframe->a0, p->trapframe->a1, p->trapframe->a2 };
+      uint64 start = r_time();
+      p->trapframe->a0 = syscalls[num]();
+      tracesyscall(num, a, p->trapframe->a0, r_time() - start);
+    } else {
+      p->trapframe->a0 = syscalls[num]();
+    }
   } else {
     printf("%d %s: unknown sys call %d\n",
             p->pid, p->name, num);
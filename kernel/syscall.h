@@ -20,3 +20,23 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_nanosleep 22
+#define SYS_clone  23
+#define SYS_join   24
+#define SYS_futex  25
+#define SYS_sched_setattr 26
+#define SYS_sched_yield 27
+#define SYS_getrusage 28
+#define SYS_procinfo 29
+#define SYS_tracedrain 30
+#define SYS_sysinfo 31
+#define SYS_setpgid 32
+#define SYS_getpgid 33
+#define SYS_tcsetpgrp 34
+#define SYS_setpriority 35
+#define SYS_getpriority 36
+#define SYS_ring_setup 37
+#define SYS_ring_enter 38
+#define SYS_trace  39
+#define SYS_profile 40
+#define SYS_profdrain 41
@@ -15,9 +15,29 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "ring.h"
+
+// The open file fd refers to, or 0.  Takes a reference,
+// which the caller must drop with fileclose(), so that the
+// file stays put if another thread closes fd meanwhile.
+static struct file*
+fdfile(int fd)
+{
+  struct proc *p = myproc()->leader;
+  struct file *f;
+
+  if(fd < 0 || fd >= NOFILE)
+    return 0;
+  acquire(&p->fdlock);
+  if((f = p->ofile[fd]) != 0)
+    filedup(f);
+  release(&p->fdlock);
+  return f;
+}
 
 // Fetch the nth word-sized system call argument as a file descriptor
-// and return both the descriptor and the corresponding struct file.
+// and return both the descriptor and the corresponding struct file,
+// with a reference that the caller must drop with fileclose().
 static int
 argfd(int n, int *pfd, struct file **pf)
 {
@@ -26,7 +46,7 @@ argfd(int n, int *pfd, struct file **pf)
 
   if(argint(n, &fd) < 0)
     return -1;
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if((f = fdfile(fd)) == 0)
     return -1;
   if(pfd)
     *pfd = fd;
@@ -41,17 +61,37 @@ static int
 fdalloc(struct file *f)
 {
   int fd;
-  struct proc *p = myproc();
+  struct proc *p = myproc()->leader;
 
+  acquire(&p->fdlock);
   for(fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd] == 0){
       p->ofile[fd] = f;
+      release(&p->fdlock);
       return fd;
     }
   }
+  release(&p->fdlock);
   return -1;
 }
 
+// Free file descriptor fd, if it still refers to f.
+// Return 0 if it did.
+static int
+fdfree(int fd, struct file *f)
+{
+  int r = -1;
+  struct proc *p = myproc()->leader;
+
+  acquire(&p->fdlock);
+  if(p->ofile[fd] == f){
+    p->ofile[fd] = 0;
+    r = 0;
+  }
+  release(&p->fdlock);
+  return r;
+}
+
 uint64
 sys_dup(void)
 {
@@ -60,9 +100,11 @@ sys_dup(void)
 
   if(argfd(0, 0, &f) < 0)
     return -1;
-  if((fd=fdalloc(f)) < 0)
+  // the new descriptor takes over argfd()'s reference.
+  if((fd=fdalloc(f)) < 0){
+    fileclose(f);
     return -1;
-  filedup(f);
+  }
   return fd;
 }
 
@@ -70,25 +112,40 @@ uint64
 sys_read(void)
 {
   struct file *f;
-  int n;
+  int n, r;
   uint64 p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p) < 0)
+  if(argint(2, &n) < 0 || argaddr(1, &p) < 0 || argfd(0, 0, &f) < 0)
     return -1;
-  return fileread(f, p, n);
+  r = fileread(f, p, n);
+  fileclose(f);
+  return r;
 }
 
 uint64
 sys_write(void)
 {
   struct file *f;
-  int n;
+  int n, r;
   uint64 p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p) < 0)
+  if(argint(2, &n) < 0 || argaddr(1, &p) < 0 || argfd(0, 0, &f) < 0)
     return -1;
+  r = filewrite(f, p, n);
+  fileclose(f);
+  return r;
+}
 
-  return filewrite(f, p, n);
+// Close fd, if it still refers to f.  The caller keeps
+// its own reference to f.
+static int
+closefd(int fd, struct file *f)
+{
+  // another thread may have closed fd already.
+  if(fdfree(fd, f) < 0)
+    return -1;
+  fileclose(f);
+  return 0;
 }
 
 uint64
@@ -97,11 +154,13 @@ sys_close(void)
   int fd;
   struct file *f;
 
+  int r;
+
   if(argfd(0, &fd, &f) < 0)
     return -1;
-  myproc()->ofile[fd] = 0;
+  r = closefd(fd, f);
   fileclose(f);
-  return 0;
+  return r;
 }
 
 uint64
@@ -109,10 +168,13 @@ sys_fstat(void)
 {
   struct file *f;
   uint64 st; // user pointer to struct stat
+  int r;
 
-  if(argfd(0, 0, &f) < 0 || argaddr(1, &st) < 0)
+  if(argaddr(1, &st) < 0 || argfd(0, 0, &f) < 0)
     return -1;
-  return filestat(f, st);
+  r = filestat(f, st);
+  fileclose(f);
+  return r;
 }
 
 // Create the path new as a link to the same inode as old.
@@ -283,17 +345,13 @@ create(char *path, short type, short major, short minor)
   return ip;
 }
 
-uint64
-sys_open(void)
+// Open path, returning a new file descriptor or -1.
+static int
+openpath(char *path, int omode)
 {
-  char path[MAXPATH];
-  int fd, omode;
+  int fd;
   struct file *f;
   struct inode *ip;
-  int n;
-
-  if((n = argstr(0, path, MAXPATH)) < 0 || argint(1, &omode) < 0)
-    return -1;
 
   begin_op();
 
@@ -351,6 +409,17 @@ sys_open(void)
   return fd;
 }
 
+uint64
+sys_open(void)
+{
+  char path[MAXPATH];
+  int omode;
+
+  if(argstr(0, path, MAXPATH) < 0 || argint(1, &omode) < 0)
+    return -1;
+  return openpath(path, omode);
+}
+
 uint64
 sys_mkdir(void)
 {
@@ -391,7 +460,7 @@ uint64
 sys_chdir(void)
 {
   char path[MAXPATH];
-  struct inode *ip;
+  struct inode *ip, *old;
   struct proc *p = myproc();
   
   begin_op();
@@ -406,9 +475,12 @@ sys_chdir(void)
     return -1;
   }
   iunlock(ip);
-  iput(p->cwd);
+  acquire(&p->leader->fdlock);
+  old = p->leader->cwd;
+  p->leader->cwd = ip;
+  release(&p->leader->fdlock);
+  iput(old);
   end_op();
-  p->cwd = ip;
   return 0;
 }
 
@@ -469,18 +541,128 @@ sys_pipe(void)
   fd0 = -1;
   if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
     if(fd0 >= 0)
-      p->ofile[fd0] = 0;
+      fdfree(fd0, rf);
     fileclose(rf);
     fileclose(wf);
     return -1;
   }
   if(copyout(p->pagetable, fdarray, (char*)&fd0, sizeof(fd0)) < 0 ||
      copyout(p->pagetable, fdarray+sizeof(fd0), (char *)&fd1, sizeof(fd1)) < 0){
-    p->ofile[fd0] = 0;
-    p->ofile[fd1] = 0;
+    fdfree(fd0, rf);
+    fdfree(fd1, wf);
     fileclose(rf);
     fileclose(wf);
     return -1;
   }
   return 0;
 }
+
+// Use the struct ring at addr for ring_enter(), or stop
+// using one if addr is 0.
+uint64
+sys_ring_setup(void)
+{
+  uint64 addr;
+
+  if(argaddr(0, &addr) < 0 || addr % sizeof(uint64))
+    return -1;
+  myproc()->ring = addr;
+  return 0;
+}
+
+// Carry out one submission entry.
+static int
+ringop(struct ringsqe *e)
+{
+  char path[MAXPATH];
+  struct file *f;
+  int r;
+
+  if(e->op == RING_OPEN){
+    if(fetchstr(e->addr, path, MAXPATH) < 0)
+      return -1;
+    return openpath(path, e->n);
+  }
+  if((f = fdfile(e->fd)) == 0)
+    return -1;
+  switch(e->op){
+  case RING_READ:
+    r = fileread(f, e->addr, e->n);
+    break;
+  case RING_WRITE:
+    r = filewrite(f, e->addr, e->n);
+    break;
+  case RING_CLOSE:
+    r = closefd(e->fd, f);
+    break;
+  case RING_FSTAT:
+    r = filestat(f, e->addr);
+    break;
+  default:
+    r = -1;
+  }
+  fileclose(f);
+  return r;
+}
+
+#define RINGOFF(field) (__builtin_offsetof(struct ring, field))
+
+// Carry out up to n entries from the submission ring, in
+// order, so that each trap into the kernel does the work of
+// many system calls.  Stops early if the completion ring
+// fills up, the process is killed, or an entry can't be
+// read or its completion written.  Returns the number of
+// entries consumed, or -1 if there was an error before any
+// were.
+uint64
+sys_ring_enter(void)
+{
+  struct proc *p = myproc();
+  struct ringsqe e;
+  struct ringcqe c;
+  uint sqhead, sqtail, cqhead, cqtail;
+  uint64 r = p->ring;
+  int n, done, bad = 0;
+
+  if(argint(0, &n) < 0 || r == 0)
+    return -1;
+  if(copyin(p->pagetable, (char*)&sqhead, r + RINGOFF(sqhead), sizeof(uint)) < 0 ||
+     copyin(p->pagetable, (char*)&sqtail, r + RINGOFF(sqtail), sizeof(uint)) < 0 ||
+     copyin(p->pagetable, (char*)&cqhead, r + RINGOFF(cqhead), sizeof(uint)) < 0 ||
+     copyin(p->pagetable, (char*)&cqtail, r + RINGOFF(cqtail), sizeof(uint)) < 0)
+    return -1;
+  if(sqtail - sqhead > NRING || cqtail - cqhead > NRING)
+    return -1;
+
+  done = 0;
+  while(done < n && sqhead != sqtail){
+    if(cqtail - cqhead == NRING || p->killed)
+      break;
+    if(copyin(p->pagetable, (char*)&e, r + RINGOFF(sq[sqhead % NRING]), sizeof(e)) < 0){
+      bad = 1;
+      break;
+    }
+    c.data = e.data;
+    c.res = ringop(&e);
+    c.pad = 0;
+    // the operation has happened, so the entry is consumed
+    // even if its completion can't be posted.
+    sqhead++;
+    done++;
+    if(copyout(p->pagetable, r + RINGOFF(cq[cqtail % NRING]), (char*)&c, sizeof(c)) < 0){
+      bad = 1;
+      break;
+    }
+    cqtail++;
+  }
+
+  // report what was done, even if it stopped part way.
+  // another thread may be watching cqtail.
+  __sync_synchronize();
+  if(copyout(p->pagetable, r + RINGOFF(sqhead), (char*)&sqhead, sizeof(uint)) < 0 ||
+     copyout(p->pagetable, r + RINGOFF(cqtail), (char*)&cqtail, sizeof(uint)) < 0)
+    return -1;
+  if(bad && done == 0)
+    return -1;
+  return done;
+}
@@ -0,0 +1,109 @@
+// Load averages and other system-wide statistics.
+//
+// The load average is the number of processes that are
+// RUNNABLE or RUNNING, decayed exponentially over 1, 5 and
+// 15 minutes, sampled every LOADTICKS ticks by whichever
+// hart's clock interrupt comes first.  While every hart is
+// idle there are no clock interrupts, and nothing to run,
+// so the next sample decays the missed intervals with zero.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "sysinfo.h"
+#include "defs.h"
+
+#define LOADTICKS (5 * TIMEFREQ / TICKINTERVAL)   // 5 seconds
+
+// FIXED_1 / exp(5 seconds / 1, 5 and 15 minutes)
+#define EXP_1   1884
+#define EXP_5   2014
+#define EXP_15  2037
+
+extern struct proc *allproc;
+
+struct {
+  struct spinlock lock;
+  uint64 avg[3];
+  uint64 next;    // tick of the next sample
+} load;
+
+void
+loadinit(void)
+{
+  initlock(&load.lock, "load");
+}
+
+// Count the processes in use, and those RUNNABLE or
+// RUNNING, without locks, since it need not be exact.
+static int
+countprocs(int *nrunning)
+{
+  struct proc *p;
+  int n = 0, r = 0;
+
+  for(p = allproc; p; p = p->allnext){
+    if(p->state != UNUSED)
+      n++;
+    if(p->state == RUNNABLE || p->state == RUNNING)
+      r++;
+  }
+  *nrunning = r;
+  return n;
+}
+
+static uint64
+decay(uint64 avg, uint64 exp, uint64 n)
+{
+  return (avg * exp + n * (FIXED_1 - exp)) >> FSHIFT;
+}
+
+// Take a load sample if one is due.  Called by clockintr().
+void
+calcload(void)
+{
+  uint64 now = r_time() / TICKINTERVAL;
+  uint64 n;
+  int r;
+
+  if(now < load.next)
+    return;
+  acquire(&load.lock);
+  if(now < load.next){
+    release(&load.lock);
+    return;
+  }
+  for(; load.next != 0 && load.next + LOADTICKS <= now; load.next += LOADTICKS){
+    load.avg[0] = decay(load.avg[0], EXP_1, 0);
+    load.avg[1] = decay(load.avg[1], EXP_5, 0);
+    load.avg[2] = decay(load.avg[2], EXP_15, 0);
+  }
+  countprocs(&r);
+  n = (uint64)r << FSHIFT;
+  load.avg[0] = decay(load.avg[0], EXP_1, n);
+  load.avg[1] = decay(load.avg[1], EXP_5, n);
+  load.avg[2] = decay(load.avg[2], EXP_15, n);
+  load.next = now + LOADTICKS;
+  release(&load.lock);
+}
+
+// Copy a struct sysinfo to user address addr.
+int
+sysinfo(uint64 addr)
+{
+  struct sysinfo si;
+
+  si.uptime = r_time() / (TIMEFREQ / 1000000);
+  acquire(&load.lock);
+  for(int i = 0; i < 3; i++)
+    si.loadavg[i] = load.avg[i];
+  release(&load.lock);
+  si.nproc = countprocs(&si.nrunning);
+  si.ncpu = ncpu;
+  for(int i = 0; i < NCPU; i++)
+    si.idle[i] = cpus[i].idletime / (TIMEFREQ / 1000000);
+  return copyout(myproc()->pagetable, addr, (char *)&si, sizeof(si));
+}
@@ -0,0 +1,14 @@
+// System-wide statistics, for sysinfo().
+// Needs param.h for NCPU.
+
+#define FSHIFT  11              // bits of fraction in loadavg[]
+#define FIXED_1 (1 << FSHIFT)   // 1.0 in that fixed point
+
+struct sysinfo {
+  uint64 uptime;        // microseconds since boot
+  uint64 loadavg[3];    // 1, 5 and 15 minute load averages
+  int nproc;            // processes and threads in use
+  int nrunning;         // of those, RUNNABLE or RUNNING now
+  int ncpu;             // harts online
+  uint64 idle[NCPU];    // each hart's idle time, in microseconds
+};
@@ -41,38 +41,225 @@ sys_wait(void)
 uint64
 sys_sbrk(void)
 {
-  int addr;
   int n;
 
   if(argint(0, &n) < 0)
     return -1;
-  addr = myproc()->sz;
-  if(growproc(n) < 0)
-    return -1;
-  return addr;
+  return growproc(n);
 }
 
 uint64
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
-  if(argint(0, &n) < 0)
+  if(argint(0, &n) < 0 || n < 0)
     return -1;
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(myproc()->killed){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
+  return twsleep(r_time() + (uint64)n * TICKINTERVAL);
+}
+
+// sleep for at least the given number of nanoseconds.
+uint64
+sys_nanosleep(void)
+{
+  uint64 ns;
+
+  if(argaddr(0, &ns) < 0)
+    return -1;
+  return twsleep(r_time() + ns / (1000000000 / TIMEFREQ));
+}
+
+// start a new thread at fn(arg), on the given stack.
+uint64
+sys_clone(void)
+{
+  uint64 fn, arg, stack;
+
+  if(argaddr(0, &fn) < 0 || argaddr(1, &arg) < 0 || argaddr(2, &stack) < 0)
+    return -1;
+  return clone(fn, arg, stack);
+}
+
+// wait for a thread to exit.
+uint64
+sys_join(void)
+{
+  int tid;
+  uint64 p;
+
+  if(argint(0, &tid) < 0 || argaddr(1, &p) < 0)
+    return -1;
+  return join(tid, p);
+}
+
+// sleep or wake on a user memory word.
+uint64
+sys_futex(void)
+{
+  uint64 addr;
+  int op, val;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &op) < 0 || argint(2, &val) < 0)
+    return -1;
+  return futex(addr, op, val);
+}
+
+// become a real-time process, asking for runtime nanoseconds
+// of CPU time within deadline of the start of every period.
+uint64
+sys_sched_setattr(void)
+{
+  uint64 runtime, deadline, period;
+
+  if(argaddr(0, &runtime) < 0 || argaddr(1, &deadline) < 0 ||
+     argaddr(2, &period) < 0)
+    return -1;
+  return edfsetattr(runtime, deadline, period);
+}
+
+// give up the CPU; a real-time process's job is done,
+// and it waits for its next period.
+uint64
+sys_sched_yield(void)
+{
+  return edfyield();
+}
+
+// CPU times of this process or its reaped children.
+uint64
+sys_getrusage(void)
+{
+  int who;
+  uint64 addr;
+
+  if(argint(0, &who) < 0 || argaddr(1, &addr) < 0)
+    return -1;
+  return getrusage(who, addr);
+}
+
+// a snapshot of the process table, for ps.
+uint64
+sys_procinfo(void)
+{
+  uint64 addr;
+  int n;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return procinfo(addr, n);
+}
+
+// start scheduler tracing, and collect the events so far.
+uint64
+sys_tracedrain(void)
+{
+  uint64 addr;
+  int n;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return tracedrain(addr, n);
+}
+
+// load averages, idle times and process counts.
+uint64
+sys_sysinfo(void)
+{
+  uint64 addr;
+
+  if(argaddr(0, &addr) < 0)
+    return -1;
+  return sysinfo(addr);
+}
+
+uint64
+sys_setpgid(void)
+{
+  int pid, pgid;
+
+  if(argint(0, &pid) < 0 || argint(1, &pgid) < 0)
+    return -1;
+  return setpgid(pid, pgid);
+}
+
+uint64
+sys_getpgid(void)
+{
+  int pid;
+
+  if(argint(0, &pid) < 0)
+    return -1;
+  return getpgid(pid);
+}
+
+// make process group pgid the console's foreground group,
+// which ^C interrupts; 0 for none.
+uint64
+sys_tcsetpgrp(void)
+{
+  int pgid;
+
+  if(argint(0, &pgid) < 0)
+    return -1;
+  return consolesetpgrp(pgid);
+}
+
+// 0 is the most urgent priority; see NPRIO.
+uint64
+sys_setpriority(void)
+{
+  int pid, prio;
+
+  if(argint(0, &pid) < 0 || argint(1, &prio) < 0)
+    return -1;
+  return setpriority(pid, prio);
+}
+
+uint64
+sys_getpriority(void)
+{
+  int pid;
+
+  if(argint(0, &pid) < 0)
+    return -1;
+  return getpriority(pid);
+}
+
+// record the system calls whose numbers are set in mask,
+// in this process and the ones it creates; see trace.c.
+uint64
+sys_trace(void)
+{
+  uint64 mask;
+
+  if(argaddr(0, &mask) < 0)
+    return -1;
+  myproc()->tracemask = mask;
   return 0;
 }
 
+// sample every hart hz times a second, or stop if hz is 0.
+uint64
+sys_profile(void)
+{
+  int hz;
+
+  if(argint(0, &hz) < 0)
+    return -1;
+  return profstart(hz);
+}
+
+uint64
+sys_profdrain(void)
+{
+  uint64 addr;
+  int n;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return profdrain(addr, n);
+}
+
 uint64
 sys_kill(void)
 {
@@ -0,0 +1,123 @@
+// Scheduler and system call event tracing.
+//
+// Scheduler events are recorded while some process is
+// draining them with tracedrain().  System calls are recorded
+// for processes that ask with trace(mask), whether or not
+// anyone is reading; syscall() checks the mask first, so an
+// untraced system call costs one test.
+//
+// Each hart records events in its own ring of NTRACE
+// events; see evring.c.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "trace.h"
+#include "evring.h"
+#include "defs.h"
+
+#define NTRACE 1024   // events per hart
+
+struct {
+  struct spinlock lock;   // one reader at a time
+  int on;
+  struct evring ring[NCPU];
+  struct trevent ev[NCPU][NTRACE];
+} trace;
+
+void
+traceinit(void)
+{
+  initlock(&trace.lock, "trace");
+  for(int i = 0; i < NCPU; i++)
+    evringinit(&trace.ring[i], trace.ev[i], sizeof(struct trevent), NTRACE);
+}
+
+// Turn interrupts off and return the next slot on this
+// hart's ring, to be filled in and then published with
+// tracepublish().
+static struct trevent*
+traceslot(int type, int pid, int arg)
+{
+  struct trevent *e;
+
+  push_off();
+  e = evringslot(&trace.ring[cpuid()]);
+  e->time = r_time();
+  e->type = type;
+  e->cpu = cpuid();
+  e->pid = pid;
+  e->arg = arg;
+  return e;
+}
+
+static void
+tracepublish(void)
+{
+  evringpush(&trace.ring[cpuid()]);
+  pop_off();
+}
+
+// Record a scheduler event on this hart's ring, if tracing
+// is on.
+void
+traceevent(int type, int pid, int arg)
+{
+  if(!trace.on)
+    return;
+  traceslot(type, pid, arg);
+  tracepublish();
+}
+
+// Record that the current process made system call num,
+// with arguments a[0..2], which returned ret after taking
+// dur cycles.  The event's time is when it returned.
+void
+tracesyscall(int num, uint64 *a, int ret, uint64 dur)
+{
+  struct trevent *e;
+
+  e = traceslot(TR_SYSCALL, myproc()->pid, num);
+  e->ret = ret;
+  e->a[0] = a[0];
+  e->a[1] = a[1];
+  e->a[2] = a[2];
+  e->dur = dur;
+  tracepublish();
+}
+
+// Turn tracing on if it is off, and copy up to n unread
+// events, hart by hart, to user address addr.  Each hart's
+// events are in time order, but not the whole.  If addr is
+// 0, turn tracing off.  Returns the number of events copied.
+int
+tracedrain(uint64 addr, int n)
+{
+  int m, got = 0;
+
+  acquire(&trace.lock);
+  if(addr == 0){
+    trace.on = 0;
+    release(&trace.lock);
+    return 0;
+  }
+  if(!trace.on){
+    // start afresh.
+    for(int i = 0; i < NCPU; i++)
+      evringskip(&trace.ring[i]);
+    trace.on = 1;
+  }
+  for(int i = 0; i < NCPU && got < n; i++){
+    if((m = evringdrain(&trace.ring[i], addr + got*sizeof(struct trevent),
+                        n - got)) < 0){
+      release(&trace.lock);
+      return -1;
+    }
+    got += m;
+  }
+  release(&trace.lock);
+  return got;
+}
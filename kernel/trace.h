@@ -0,0 +1,19 @@
+// Scheduler and system call trace events; see trace.c.
+
+#define TR_SWITCHIN   1   // pid starts running
+#define TR_SWITCHOUT  2   // pid stops running; arg is its new state
+#define TR_WAKEUP     3   // pid becomes RUNNABLE
+#define TR_FORK       4   // pid is created; arg is its parent's pid
+#define TR_EXIT       5   // pid exits; arg is its status
+#define TR_SYSCALL    6   // pid made system call arg; see trace()
+
+struct trevent {
+  uint64 time;    // CLINT timer cycles
+  short type;     // TR_*
+  short cpu;
+  int pid;
+  int arg;
+  int ret;        // TR_SYSCALL: the return value,
+  uint64 a[3];    //   the first three arguments,
+  uint64 dur;     //   and how many cycles it took
+};
@@ -15,11 +15,12 @@ extern char trampoline[], uservec[], userret[];
 void kernelvec();
 
 extern int devintr();
+static int handleintr(void);
 
 void
 trapinit(void)
 {
-  initlock(&tickslock, "time");
+  initlockkind(&tickslock, "time", HOTLOCKKIND);
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -27,6 +28,9 @@ void
 trapinithart(void)
 {
   w_stvec((uint64)kernelvec);
+
+  // allow user mode to read the time CSR, e.g. for rtbench.
+  w_scounteren(r_scounteren() | 2);
 }
 
 //
@@ -46,6 +50,8 @@ usertrap(void)
   w_stvec((uint64)kernelvec);
 
   struct proc *p = myproc();
+  charge(p, &p->utime);
+  rcuquiescent();
   
   // save user program counter.
   p->trapframe->epc = r_sepc();
@@ -67,6 +73,9 @@ usertrap(void)
     syscall();
   } else if((which_dev = devintr()) != 0){
     // ok
+  } else if(r_scause() == 2 && fptrap() == 0){
+    // first floating-point instruction since the process
+    // last ran on this hart; retry it.
   } else {
     printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
     printf("            sepc=%p stval=%p\n", r_sepc(), r_stval());
@@ -76,9 +85,12 @@ usertrap(void)
   if(p->killed)
     exit(-1);
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2)
+  // give up the CPU if this is a timer interrupt,
+  // or throttle a real-time process out of budget.
+  if(which_dev == 2){
+    edftick();
     yield();
+  }
 
   usertrapret();
 }
@@ -95,6 +107,7 @@ usertrapret(void)
   // kerneltrap() to usertrap(), so turn off interrupts until
   // we're back in user space, where usertrap() is correct.
   intr_off();
+  charge(p, &p->stime);
 
   // send syscalls, interrupts, and exceptions to trampoline.S
   w_stvec(TRAMPOLINE + (uservec - trampoline));
@@ -113,6 +126,7 @@ usertrapret(void)
   unsigned long x = r_sstatus();
   x &= ~SSTATUS_SPP; // clear SPP to 0 for user mode
   x |= SSTATUS_SPIE; // enable interrupts in user mode
+  x = fpuserstatus(x); // floating point on only if loaded
   w_sstatus(x);
 
   // set S Exception Program Counter to the saved user pc.
@@ -125,7 +139,7 @@ usertrapret(void)
   // switches to the user page table, restores user registers,
   // and switches to user mode with sret.
   uint64 fn = TRAMPOLINE + (userret - trampoline);
-  ((void (*)(uint64,uint64))fn)(TRAPFRAME, satp);
+  ((void (*)(uint64,uint64))fn)(THREADFRAME(p->tslot), satp);
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -163,9 +177,9 @@ void
 clockintr()
 {
   acquire(&tickslock);
-  ticks++;
-  wakeup(&ticks);
+  ticks = r_time() / TICKINTERVAL;
   release(&tickslock);
+  calcload();
 }
 
 // check if it's an external interrupt or software interrupt,
@@ -175,6 +189,22 @@ clockintr()
 // 0 if not recognized.
 int
 devintr()
+{
+  int r;
+
+#ifdef LOCKDEP
+  // lockdep checks what interrupt handlers lock.
+  mycpu()->inintr++;
+  r = handleintr();
+  mycpu()->inintr--;
+#else
+  r = handleintr();
+#endif
+  return r;
+}
+
+static int
+handleintr(void)
 {
   uint64 scause = r_scause();
 
@@ -201,17 +231,30 @@ devintr()
 
     return 1;
   } else if(scause == 0x8000000000000001L){
-    // software interrupt from a machine-mode timer interrupt,
-    // forwarded by timervec in kernelvec.S.
+    // software interrupt from a machine-mode timer interrupt
+    // or IPI, forwarded by timervec in kernelvec.S.
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-    
     // acknowledge the software interrupt by clearing
-    // the SSIP bit in sip.
+    // the SSIP bit in sip.  do it first, so that an IPI
+    // queued while we look is not lost.
     w_sip(r_sip() & ~2);
 
+    // act on any messages from other harts.
+    ipiintr();
+
+    // any hart may be the only one still taking clock
+    // interrupts, the others having gone idle.
+    clockintr();
+
+    // sample what was interrupted, if profiling.
+    profintr();
+
+    // any hart may have armed a one-shot timer for a sleeper.
+    twexpire();
+
+    // the caller yields if it can; if not, the next
+    // preemption point does.
+    mycpu()->resched = 1;
     return 2;
   } else {
     return 0;
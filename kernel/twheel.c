@@ -0,0 +1,161 @@
+// Timer wheel for sleeping processes.
+//
+// A process sleeping until a deadline is hashed into one of
+// NSLOT slots by the tick in which its deadline falls.  Each
+// timer interrupt only looks at the slots for the ticks that
+// have passed since the last scan, and wakes just the
+// processes whose deadlines have expired, instead of waking
+// every sleeper to re-check its own deadline.
+//
+// Deadlines are in CLINT timer cycles (see TIMEFREQ), so they
+// need not fall on a tick.  A sleeper whose deadline comes
+// before the next tick asks its hart for a one-shot timer
+// interrupt with timerarm().
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define NSLOT 64
+
+struct {
+  struct spinlock lock;
+  struct proc *slot[NSLOT];
+  uint64 last;  // tick of the last call to twexpire()
+} tw;
+
+void
+twinit(void)
+{
+  initlock(&tw.lock, "twheel");
+  tw.last = r_time() / TICKINTERVAL;
+}
+
+static struct proc**
+twslot(uint64 deadline)
+{
+  return &tw.slot[(deadline / TICKINTERVAL) % NSLOT];
+}
+
+// Caller must hold tw.lock.
+static void
+twinsert(struct proc *p)
+{
+  struct proc **head = twslot(p->deadline);
+
+  p->twprev = 0;
+  p->twnext = *head;
+  if(*head)
+    (*head)->twprev = p;
+  *head = p;
+}
+
+// Caller must hold tw.lock.
+static void
+twremove(struct proc *p)
+{
+  if(p->twprev)
+    p->twprev->twnext = p->twnext;
+  else
+    *twslot(p->deadline) = p->twnext;
+  if(p->twnext)
+    p->twnext->twprev = p->twprev;
+  p->twnext = 0;
+  p->twprev = 0;
+  p->deadline = 0;
+}
+
+// Sleep until the timer reaches deadline.
+// Returns -1 if the process was killed first.
+int
+twsleep(uint64 deadline)
+{
+  struct proc *p = myproc();
+
+  acquire(&tw.lock);
+  if(deadline <= r_time()){
+    release(&tw.lock);
+    return 0;
+  }
+
+  p->deadline = deadline;
+  twinsert(p);
+  if(deadline - r_time() < TICKINTERVAL)
+    timerarm(deadline);
+
+  // twexpire() clears p->deadline when it wakes us.
+  while(p->deadline != 0){
+    if(p->killed){
+      twremove(p);
+      release(&tw.lock);
+      return -1;
+    }
+    sleep(&p->deadline, &tw.lock);
+  }
+  release(&tw.lock);
+  return 0;
+}
+
+// Return the earliest deadline of any sleeper,
+// or 0 if there are none.
+uint64
+twnext(void)
+{
+  struct proc *p;
+  uint64 next = 0;
+
+  acquire(&tw.lock);
+  for(int i = 0; i < NSLOT; i++){
+    for(p = tw.slot[i]; p; p = p->twnext){
+      if(next == 0 || p->deadline < next)
+        next = p->deadline;
+    }
+  }
+  release(&tw.lock);
+  return next;
+}
+
+// Wake the processes whose deadlines have passed.
+// Called on every timer interrupt, on every hart.
+void
+twexpire(void)
+{
+  struct proc *p, *np;
+  uint64 now, t;
+
+  acquire(&tw.lock);
+  now = r_time();
+
+  // scan the slots of every tick since the last call,
+  // including the current one again, since sleepers
+  // with sub-tick deadlines may have landed in it.
+  t = tw.last;
+  if(now / TICKINTERVAL - t >= NSLOT)
+    t = now / TICKINTERVAL - NSLOT + 1;
+  for(; t <= now / TICKINTERVAL; t++){
+    for(p = tw.slot[t % NSLOT]; p; p = np){
+      np = p->twnext;
+      if(p->deadline <= now){
+        twremove(p);
+        wakeproc(p, &p->deadline);
+      }
+    }
+  }
+  tw.last = now / TICKINTERVAL;
+
+  // a sleeper due later in this tick would otherwise wait
+  // for the next tick.
+  t = 0;
+  for(p = tw.slot[tw.last % NSLOT]; p; p = p->twnext){
+    if(p->deadline / TICKINTERVAL == tw.last && (t == 0 || p->deadline < t))
+      t = p->deadline;
+  }
+  if(t)
+    timerarm(t);
+
+  release(&tw.lock);
+}
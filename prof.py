@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+
+"""Turn the output of xv6's prof into folded stacks.
+
+  python3 prof.py [output] > prof.folded
+  flamegraph.pl prof.folded > prof.svg
+
+Reads prof's lines, from a file or stdin (other lines, such as
+the rest of a console log, are skipped), and names each pc with
+the symbols in kernel/kernel.sym for kernel samples, or in
+user/<name>.sym for user samples of the process called name.
+Writes one line per stack, root first, with its sample count:
+  name;caller;...;callee count
+"""
+
+import bisect
+import os
+import sys
+
+TOP = os.path.dirname(os.path.abspath(__file__))
+
+symtabs = {}
+
+
+def loadsyms(path):
+    """Return sorted addresses and their names from an objdump -t .sym file."""
+    syms = []
+    try:
+        with open(path) as f:
+            for line in f:
+                fields = line.split()
+                if len(fields) != 2:
+                    continue
+                try:
+                    syms.append((int(fields[0], 16), fields[1]))
+                except ValueError:
+                    pass
+    except OSError:
+        pass
+    syms.sort()
+    return [a for a, _ in syms], [n for _, n in syms]
+
+
+def symtab(user, name):
+    path = os.path.join(TOP, "user", name + ".sym") if user else \
+        os.path.join(TOP, "kernel", "kernel.sym")
+    if path not in symtabs:
+        symtabs[path] = loadsyms(path)
+    return symtabs[path]
+
+
+def symbolize(pc, user, name):
+    addrs, names = symtab(user, name)
+    i = bisect.bisect_right(addrs, pc) - 1
+    if i < 0:
+        return "0x%x" % pc
+    return names[i]
+
+
+def main():
+    f = open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin
+    folded = {}
+    for line in f:
+        fields = line.split()
+        if len(fields) < 4 or fields[0] != "prof" or fields[2] not in ("k", "u"):
+            continue
+        try:
+            count = int(fields[1])
+            pcs = [int(x, 16) for x in fields[4:]]
+        except ValueError:
+            continue
+        user = fields[2] == "u"
+        name = fields[3]
+        # return addresses point after the call; back up
+        # into it, in case the call is a function's last.
+        frames = [symbolize(pc if i == 0 else pc - 1, user, name)
+                  for i, pc in enumerate(pcs)]
+        frames.reverse()
+        key = ";".join([name + (" [user]" if user else " [kernel]")] + frames)
+        folded[key] = folded.get(key, 0) + count
+    for key in sorted(folded):
+        print(key, folded[key])
+
+
+if __name__ == "__main__":
+    main()
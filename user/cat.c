@@ -1,16 +1,19 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/ring.h"
 #include "user/user.h"
 
-char buf[512];
+char buf[2][512];
+struct ring *ring;
 
+// Without a ring: one system call per read or write.
 void
-cat(int fd)
+cat1(int fd)
 {
   int n;
 
-  while((n = read(fd, buf, sizeof(buf))) > 0) {
-    if (write(1, buf, n) != n) {
+  while((n = read(fd, buf[0], sizeof(buf[0]))) > 0) {
+    if (write(1, buf[0], n) != n) {
       fprintf(2, "cat: write error\n");
       exit(1);
     }
@@ -21,11 +24,56 @@ cat(int fd)
   }
 }
 
+// Each ring_enter() writes out what the last one read and
+// reads the next block into the other buffer, so one trap
+// does the work of two system calls.
+void
+cat(int fd)
+{
+  struct ringcqe c;
+  int cur = 0, n = 0, got = 0, nop;
+
+  if(ring == 0){
+    cat1(fd);
+    return;
+  }
+  for(;;){
+    nop = 0;
+    if(n > 0){
+      ring_prep(ring, RING_WRITE, 1, buf[cur], n, RING_WRITE);
+      nop++;
+    }
+    cur ^= 1;
+    ring_prep(ring, RING_READ, fd, buf[cur], sizeof(buf[cur]), RING_READ);
+    nop++;
+    if(ring_enter(nop) != nop){
+      fprintf(2, "cat: ring_enter failed\n");
+      exit(1);
+    }
+    while(ring_reap(ring, &c)){
+      if(c.data == RING_WRITE && c.res != n){
+        fprintf(2, "cat: write error\n");
+        exit(1);
+      }
+      if(c.data == RING_READ)
+        got = c.res;
+    }
+    if(got < 0){
+      fprintf(2, "cat: read error\n");
+      exit(1);
+    }
+    if(got == 0)
+      break;
+    n = got;
+  }
+}
+
 int
 main(int argc, char *argv[])
 {
   int fd, i;
 
+  ring = ring_init();
   if(argc <= 1){
     cat(0);
     exit(0);
@@ -2,11 +2,60 @@
 
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/ring.h"
 #include "user/user.h"
 
 char buf[1024];
+char out[1024];   // matching lines not yet written
+int nout;
+struct ring *ring;
 int match(char*, char*);
 
+// Write out the matching lines gathered so far, then read up
+// to n bytes from fd into p.  With a ring, one ring_enter()
+// does both, so each block costs one trap rather than one
+// per matching line and one to read.
+int
+flushread(int fd, char *p, int n)
+{
+  struct ringcqe c;
+  int r = -1, nop = 0;
+
+  if(ring == 0){
+    if(nout > 0)
+      write(1, out, nout);
+    nout = 0;
+    return read(fd, p, n);
+  }
+  if(nout > 0){
+    ring_prep(ring, RING_WRITE, 1, out, nout, RING_WRITE);
+    nop++;
+  }
+  ring_prep(ring, RING_READ, fd, p, n, RING_READ);
+  nop++;
+  nout = 0;
+  if(ring_enter(nop) != nop){
+    fprintf(2, "grep: ring_enter failed\n");
+    exit(1);
+  }
+  while(ring_reap(ring, &c))
+    if(c.data == RING_READ)
+      r = c.res;
+  return r;
+}
+
+// Add a matching line to out.
+void
+emit(char *p, int n)
+{
+  if(nout + n > sizeof(out)){
+    write(1, out, nout);
+    nout = 0;
+  }
+  memmove(out + nout, p, n);
+  nout += n;
+}
+
 void
 grep(char *pattern, int fd)
 {
@@ -14,7 +63,7 @@ grep(char *pattern, int fd)
   char *p, *q;
 
   m = 0;
-  while((n = read(fd, buf+m, sizeof(buf)-m-1)) > 0){
+  while((n = flushread(fd, buf+m, sizeof(buf)-m-1)) > 0){
     m += n;
     buf[m] = '\0';
     p = buf;
@@ -22,7 +71,7 @@ grep(char *pattern, int fd)
       *q = 0;
       if(match(pattern, p)){
         *q = '\n';
-        write(1, p, q+1 - p);
+        emit(p, q+1 - p);
       }
       p = q+1;
     }
@@ -44,6 +93,7 @@ main(int argc, char *argv[])
     exit(1);
   }
   pattern = argv[1];
+  ring = ring_init();
 
   if(argc <= 2){
     grep(pattern, 0);
@@ -8,10 +8,14 @@ main(int argc, char **argv)
   int i;
 
   if(argc < 2){
-    fprintf(2, "usage: kill pid...\n");
+    fprintf(2, "usage: kill pid|-pgid...\n");
     exit(1);
   }
-  for(i=1; i<argc; i++)
-    kill(atoi(argv[i]));
+  for(i=1; i<argc; i++){
+    if(argv[i][0] == '-')
+      kill(-atoi(argv[i]+1));
+    else
+      kill(atoi(argv[i]));
+  }
   exit(0);
 }
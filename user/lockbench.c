@@ -0,0 +1,185 @@
+// Measure the throughput and fairness of a hot kernel lock.
+//
+// lockbench [-n nproc] [-t ms] kmem|bcache|time
+//
+// Starts nproc processes (default NCPU) that for ms
+// milliseconds (default 1000) each repeat an operation that
+// takes the lock:
+//   kmem     sbrk() a few pages and give them back;
+//   bcache   read a block of a file;
+//   time     uptime_trap(), which takes tickslock.
+// Then prints the operations per second, how evenly they were
+// shared (the fewest and most done by one process, and Jain's
+// fairness index, 100 when all did the same), and how many of
+// the lock's acquisitions had to wait.  Build the kernel with
+// different HOTLOCKKINDs to compare the kinds of spinlock.
+
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+#define FILE  "lockbench.tmp"
+#define NPAGE 4
+#define NWORKER 64
+
+static uint64
+now(void)
+{
+  uint64 x;
+  asm volatile("rdtime %0" : "=r" (x));
+  return x;
+}
+
+static void
+usage(void)
+{
+  fprintf(2, "usage: lockbench [-n nproc] [-t ms] kmem|bcache|time\n");
+  exit(1);
+}
+
+// Do the operation until end, and return how many times.
+static int
+run(char *lock, uint64 start, uint64 end)
+{
+  char buf[BSIZE];
+  int n = 0, fd = -1;
+
+  while(now() < start)
+    ;
+  while(now() < end){
+    if(strcmp(lock, "kmem") == 0){
+      if(sbrk(NPAGE * PGSIZE) == (char*)-1)
+        return -1;
+      sbrk(-NPAGE * PGSIZE);
+    } else if(strcmp(lock, "bcache") == 0){
+      if(fd < 0 && (fd = open(FILE, O_RDONLY)) < 0)
+        return -1;
+      if(read(fd, buf, sizeof(buf)) != sizeof(buf)){
+        close(fd);
+        fd = -1;
+      }
+    } else {
+      uptime_trap();
+    }
+    n++;
+  }
+  return n;
+}
+
+// Print the lock's line from the statistics device.
+static void
+contention(char *lock)
+{
+  static char stats[8192];
+  char *s, *e, *name;
+  int n, tabs;
+
+  if((n = statistics(stats, sizeof(stats) - 1)) < 0)
+    return;
+  stats[n] = 0;
+  for(s = stats; *s; s = e + 1){
+    if((e = strchr(s, '\n')) == 0)
+      break;
+    *e = 0;
+    // the name is the last of seven fields.
+    for(name = s, tabs = 0; *name && tabs < 6; name++)
+      if(*name == '\t')
+        tabs++;
+    if(strcmp(name, lock) == 0 && memcmp(s, "spin\t", 5) == 0)
+      printf("kind\tacquire\tcontend\tspin\tsleep\thold\tname\n%s\n", s);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nproc = NCPU, ms = 1000, fds[2], fd, n;
+  int counts[NWORKER], min, max;
+  uint64 start, end, sum, sumsq;
+  char *lock, block[BSIZE];
+
+  while(argc > 2 && argv[1][0] == '-'){
+    if(strcmp(argv[1], "-n") == 0)
+      nproc = atoi(argv[2]);
+    else if(strcmp(argv[1], "-t") == 0)
+      ms = atoi(argv[2]);
+    else
+      usage();
+    argc -= 2;
+    argv += 2;
+  }
+  if(argc != 2 || nproc < 1 || nproc > NWORKER || ms <= 0)
+    usage();
+  lock = argv[1];
+  if(strcmp(lock, "kmem") && strcmp(lock, "bcache") && strcmp(lock, "time"))
+    usage();
+
+  if(strcmp(lock, "bcache") == 0){
+    if((fd = open(FILE, O_CREATE | O_WRONLY)) < 0){
+      fprintf(2, "lockbench: cannot create %s\n", FILE);
+      exit(1);
+    }
+    memset(block, 'x', sizeof(block));
+    for(int i = 0; i < 4; i++)
+      write(fd, block, sizeof(block));
+    close(fd);
+  }
+
+  // zero the lock statistics.
+  if((fd = open("statistics", O_WRONLY)) >= 0){
+    write(fd, "r", 1);
+    close(fd);
+  }
+
+  if(pipe(fds) < 0){
+    fprintf(2, "lockbench: pipe failed\n");
+    exit(1);
+  }
+  // give the processes time to start before they all begin.
+  start = now() + TIMEFREQ / 10;
+  end = start + (uint64)ms * (TIMEFREQ / 1000);
+  for(int i = 0; i < nproc; i++){
+    if((n = fork()) < 0){
+      fprintf(2, "lockbench: fork failed\n");
+      exit(1);
+    }
+    if(n == 0){
+      close(fds[0]);
+      n = run(lock, start, end);
+      write(fds[1], &n, sizeof(n));
+      exit(0);
+    }
+  }
+  close(fds[1]);
+  for(int i = 0; i < nproc; i++){
+    if(read(fds[0], &counts[i], sizeof(counts[i])) != sizeof(counts[i]) ||
+       counts[i] < 0){
+      fprintf(2, "lockbench: a process failed\n");
+      exit(1);
+    }
+    wait(0);
+  }
+  close(fds[0]);
+
+  sum = sumsq = 0;
+  min = max = counts[0];
+  for(int i = 0; i < nproc; i++){
+    sum += counts[i];
+    sumsq += (uint64)counts[i] * counts[i];
+    if(counts[i] < min)
+      min = counts[i];
+    if(counts[i] > max)
+      max = counts[i];
+  }
+  printf("%s: %d procs, %d ops/s, per proc min %d max %d, fairness %d\n",
+         lock, nproc, (int)(sum * 1000 / ms), min, max,
+         sumsq ? (int)(sum * sum * 100 / (nproc * sumsq)) : 100);
+  contention(lock);
+
+  if(strcmp(lock, "bcache") == 0)
+    unlink(FILE);
+  exit(0);
+}
@@ -0,0 +1,132 @@
+// Report lock contention, from the statistics device.
+//
+// lockstat [-r] [n]
+//
+// Prints the n (default 20) most contended kinds of lock,
+// with how often each was acquired and had to wait, how
+// many times it spun and, for a sleeplock, slept, and how
+// long, in timer cycles, it was held on average.  -r zeroes
+// the counters first and runs for a second, so that the
+// report covers just that second.
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define BUFSZ 8192
+#define NLOCK 64
+
+struct lock {
+  char *kind;
+  uint64 nacquire;
+  uint64 ncontended;
+  uint64 nspin;
+  uint64 nsleep;
+  uint64 holdtime;
+  char *name;
+};
+
+char buf[BUFSZ];
+struct lock locks[NLOCK];
+
+// Parse a decimal field ending in a tab, and step past it.
+static uint64
+number(char **sp)
+{
+  uint64 x = 0;
+  char *s = *sp;
+
+  while(*s >= '0' && *s <= '9')
+    x = x * 10 + *s++ - '0';
+  if(*s == '\t')
+    s++;
+  *sp = s;
+  return x;
+}
+
+// Return the text up to the next tab or newline, which
+// is replaced with a 0, and step past it.
+static char*
+field(char **sp)
+{
+  char *s = *sp, *f = s;
+
+  while(*s && *s != '\t' && *s != '\n')
+    s++;
+  if(*s)
+    *s++ = 0;
+  *sp = s;
+  return f;
+}
+
+static int
+parse(char *s)
+{
+  struct lock *l;
+  int n = 0;
+
+  while(*s && n < NLOCK){
+    l = &locks[n++];
+    l->kind = field(&s);
+    l->nacquire = number(&s);
+    l->ncontended = number(&s);
+    l->nspin = number(&s);
+    l->nsleep = number(&s);
+    l->holdtime = number(&s);
+    l->name = field(&s);
+  }
+  return n;
+}
+
+// most contended first, then most sleeps and spins.
+static int
+before(struct lock *a, struct lock *b)
+{
+  if(a->ncontended != b->ncontended)
+    return a->ncontended > b->ncontended;
+  if(a->nsleep != b->nsleep)
+    return a->nsleep > b->nsleep;
+  return a->nspin > b->nspin;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct lock t;
+  int fd, n, max = 20;
+
+  if(argc > 1 && strcmp(argv[1], "-r") == 0){
+    if((fd = open("statistics", O_WRONLY)) < 0 || write(fd, "r", 1) != 1){
+      fprintf(2, "lockstat: cannot reset statistics\n");
+      exit(1);
+    }
+    close(fd);
+    sleep(10);
+    argc--;
+    argv++;
+  }
+  if(argc > 1)
+    max = atoi(argv[1]);
+
+  if((n = statistics(buf, BUFSZ - 1)) < 0){
+    fprintf(2, "lockstat: cannot read statistics\n");
+    exit(1);
+  }
+  buf[n] = 0;
+  n = parse(buf);
+
+  // insertion sort.
+  for(int i = 1; i < n; i++){
+    for(int j = i; j > 0 && before(&locks[j], &locks[j-1]); j--){
+      t = locks[j]; locks[j] = locks[j-1]; locks[j-1] = t;
+    }
+  }
+
+  printf("KIND\tACQUIRE\tCONTEND\tSPIN\tSLEEP\tHOLD\tNAME\n");
+  for(int i = 0; i < n && i < max; i++){
+    printf("%s\t%l\t%l\t%l\t%l\t%l\t%s\n", locks[i].kind, locks[i].nacquire,
+           locks[i].ncontended, locks[i].nspin, locks[i].nsleep,
+           locks[i].holdtime / locks[i].nacquire, locks[i].name);
+  }
+  exit(0);
+}
@@ -0,0 +1,155 @@
+// Sampling profiler.
+//
+// prof [-f hz] command [arg ...]
+// prof [-f hz] -t ticks
+//
+// Samples every hart hz times a second (default 1000) while
+// command runs, or for ticks clock ticks, then prints a line
+// for each distinct stack seen:
+//   prof count k|u name pc pc ...
+// k for a sample in the kernel, u in user space, with the
+// interrupted pc first and then the return addresses.  Run
+// prof.py on the host over the output to get folded stacks
+// for a flame graph.
+
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/prof.h"
+#include "user/user.h"
+
+#define NSAMPLE 1024
+#define NSTACK 2048    // distinct stacks kept; a power of two
+
+struct stack {
+  struct profsample s;
+  int count;
+};
+
+struct profsample buf[NSAMPLE];
+struct stack *stacks;
+int nstack, lost;
+volatile int done;
+
+static int
+same(struct profsample *a, struct profsample *b)
+{
+  if(a->user != b->user || a->depth != b->depth ||
+     strcmp(a->name, b->name) != 0)
+    return 0;
+  return memcmp(a->pc, b->pc, a->depth * sizeof(a->pc[0])) == 0;
+}
+
+// count sample s under its stack.
+static void
+add(struct profsample *s)
+{
+  uint h = s->user;
+  int i;
+
+  for(i = 0; i < s->depth; i++)
+    h = h * 31 + (uint)s->pc[i];
+  for(i = 0; i < NSTACK; i++){
+    struct stack *st = &stacks[(h + i) & (NSTACK-1)];
+    if(st->count == 0){
+      st->s = *s;
+      st->count = 1;
+      nstack++;
+      return;
+    }
+    if(same(&st->s, s)){
+      st->count++;
+      return;
+    }
+  }
+  lost++;
+}
+
+static void
+drain(void)
+{
+  int n;
+
+  while((n = profdrain(buf, NSAMPLE)) > 0)
+    for(int i = 0; i < n; i++)
+      add(&buf[i]);
+}
+
+// drain often enough that the kernel's rings don't overflow.
+static void
+drainer(void *arg)
+{
+  while(!done){
+    nanosleep(10000000);
+    drain();
+  }
+}
+
+static void
+usage(void)
+{
+  fprintf(2, "usage: prof [-f hz] command [arg ...] | prof [-f hz] -t ticks\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int hz = 1000, ticks = 0, pid = -1, tid, total = 0;
+  struct stack *st;
+
+  if(argc > 2 && strcmp(argv[1], "-f") == 0){
+    hz = atoi(argv[2]);
+    argc -= 2;
+    argv += 2;
+  }
+  if(argc == 3 && strcmp(argv[1], "-t") == 0)
+    ticks = atoi(argv[2]);
+  else if(argc < 2)
+    usage();
+  if((stacks = malloc(NSTACK * sizeof(*stacks))) == 0){
+    fprintf(2, "prof: out of memory\n");
+    exit(1);
+  }
+  memset(stacks, 0, NSTACK * sizeof(*stacks));
+
+  if(profile(hz) < 0){
+    fprintf(2, "prof: bad frequency %d\n", hz);
+    exit(1);
+  }
+  if((tid = thread_create(drainer, 0)) < 0){
+    fprintf(2, "prof: thread_create failed\n");
+    profile(0);
+    exit(1);
+  }
+  if(ticks){
+    sleep(ticks);
+  } else if((pid = fork()) == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "prof: exec %s failed\n", argv[1]);
+    exit(1);
+  } else if(pid < 0){
+    fprintf(2, "prof: fork failed\n");
+  } else {
+    wait(0);
+  }
+  profile(0);
+  done = 1;
+  thread_join(tid);
+  drain();
+
+  for(int i = 0; i < NSTACK; i++){
+    st = &stacks[i];
+    if(st->count == 0)
+      continue;
+    total += st->count;
+    printf("prof %d %c %s", st->count, st->s.user ? 'u' : 'k', st->s.name);
+    for(int j = 0; j < st->s.depth; j++)
+      printf(" %x", (int)st->s.pc[j]);
+    printf("\n");
+  }
+  fprintf(2, "prof: %d samples, %d stacks", total, nstack);
+  if(lost)
+    fprintf(2, ", %d samples lost", lost);
+  fprintf(2, "\n");
+  exit(0);
+}
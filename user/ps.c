@@ -0,0 +1,140 @@
+// List processes and the CPU time they have used.
+//
+// ps            every process and thread, with its user, system
+//               and waiting times in milliseconds.
+// ps -t [n]     like top: the CPU use of each over the next n
+//               ticks (default 10), busiest first.
+
+#include "kernel/types.h"
+#include "kernel/pstat.h"
+#include "user/user.h"
+
+static char *states[] = {
+  [0] "unused",
+  [1] "used",
+  [2] "sleep",
+  [3] "runble",
+  [4] "run",
+  [5] "zombie",
+};
+
+static char*
+statename(int state)
+{
+  if(state >= 0 && state < sizeof(states)/sizeof(states[0]))
+    return states[state];
+  return "???";
+}
+
+// Read the process table into a malloc'd array,
+// growing it until everything fits.  Sets *np.
+static struct procinfo*
+snapshot(int *np)
+{
+  struct procinfo *pi;
+  int max = 32, n;
+
+  for(;;){
+    if((pi = malloc(max * sizeof(*pi))) == 0){
+      fprintf(2, "ps: out of memory\n");
+      exit(1);
+    }
+    if((n = procinfo(pi, max)) < 0){
+      fprintf(2, "ps: procinfo failed\n");
+      exit(1);
+    }
+    if(n < max){
+      *np = n;
+      return pi;
+    }
+    free(pi);
+    max *= 2;
+  }
+}
+
+static uint64
+cputime(struct procinfo *p)
+{
+  return p->ru.utime + p->ru.stime;
+}
+
+static void
+list(void)
+{
+  struct procinfo *pi;
+  int n;
+
+  pi = snapshot(&n);
+  printf("PID\tPPID\tTGID\tSTATE\tSIZE\tUSER\tSYS\tWAIT\tNAME\n");
+  for(int i = 0; i < n; i++){
+    printf("%d\t%d\t%d\t%s\t%d\t%d\t%d\t%d\t%s\n",
+           pi[i].pid, pi[i].ppid, pi[i].tgid, statename(pi[i].state),
+           (int)pi[i].sz, (int)(pi[i].ru.utime / 1000),
+           (int)(pi[i].ru.stime / 1000), (int)(pi[i].ru.wtime / 1000),
+           pi[i].name);
+  }
+  free(pi);
+}
+
+static void
+top(int ticks)
+{
+  struct procinfo *a, *b, t;
+  uint64 *used, u;
+  int na, nb, t0, elapsed;
+
+  a = snapshot(&na);
+  t0 = uptime();
+  sleep(ticks);
+  b = snapshot(&nb);
+  if((elapsed = uptime() - t0) <= 0)
+    elapsed = 1;
+  if((used = malloc(nb * sizeof(*used))) == 0){
+    fprintf(2, "ps: out of memory\n");
+    exit(1);
+  }
+
+  // CPU time of each process over the interval; a process
+  // new since the first snapshot counts from its start.
+  for(int i = 0; i < nb; i++){
+    used[i] = cputime(&b[i]);
+    for(int j = 0; j < na; j++){
+      if(a[j].pid == b[i].pid){
+        used[i] -= cputime(&a[j]) < used[i] ? cputime(&a[j]) : used[i];
+        break;
+      }
+    }
+  }
+
+  // insertion sort, busiest first.
+  for(int i = 1; i < nb; i++){
+    for(int j = i; j > 0 && used[j] > used[j-1]; j--){
+      t = b[j]; b[j] = b[j-1]; b[j-1] = t;
+      u = used[j]; used[j] = used[j-1]; used[j-1] = u;
+    }
+  }
+
+  // a tick is about 100ms, so %CPU is used / (elapsed * 1000).
+  printf("PID\tSTATE\t%%CPU\tNAME\n");
+  for(int i = 0; i < nb; i++){
+    printf("%d\t%s\t%d\t%s\n", b[i].pid, statename(b[i].state),
+           (int)(used[i] / (elapsed * 1000)), b[i].name);
+  }
+  free(used);
+  free(a);
+  free(b);
+}
+
+int
+main(int argc, char *argv[])
+{
+  if(argc == 1){
+    list();
+  } else if(strcmp(argv[1], "-t") == 0 && argc <= 3){
+    top(argc == 3 ? atoi(argv[2]) : 10);
+  } else {
+    fprintf(2, "usage: ps [-t [ticks]]\n");
+    exit(1);
+  }
+  exit(0);
+}
@@ -0,0 +1,51 @@
+#include "kernel/types.h"
+#include "kernel/ring.h"
+#include "user/user.h"
+
+// Allocate a ring and tell the kernel about it.
+// Returns 0 if the kernel won't have it.
+struct ring*
+ring_init(void)
+{
+  struct ring *r;
+
+  if((r = malloc(sizeof(*r))) == 0)
+    return 0;
+  memset(r, 0, sizeof(*r));
+  if(ring_setup(r) < 0){
+    free(r);
+    return 0;
+  }
+  return r;
+}
+
+// Queue an operation for the next ring_enter().
+// Returns -1 if the submission ring is full.
+int
+ring_prep(struct ring *r, int op, int fd, void *addr, int n, uint64 data)
+{
+  struct ringsqe *e;
+
+  if(r->sqtail - r->sqhead == NRING)
+    return -1;
+  e = &r->sq[r->sqtail % NRING];
+  e->op = op;
+  e->fd = fd;
+  e->addr = (uint64)addr;
+  e->n = n;
+  e->data = data;
+  r->sqtail++;
+  return 0;
+}
+
+// Take the next completion into *c.
+// Returns 0 if there is none.
+int
+ring_reap(struct ring *r, struct ringcqe *c)
+{
+  if(r->cqhead == r->cqtail)
+    return 0;
+  *c = r->cq[r->cqhead % NRING];
+  r->cqhead++;
+  return 1;
+}
@@ -0,0 +1,107 @@
+// Measure how well a real-time process keeps its deadlines.
+//
+// rtbench [-l nload] runtime deadline period njobs
+//
+// Times are in microseconds.  The process asks for runtime
+// within deadline of each period, then runs njobs jobs, each
+// spinning for most of its runtime.  It reports the release
+// jitter, how late each job started after its period began,
+// and how many jobs finished after their deadlines.  -l starts
+// nload normal processes that spin the whole time, to show
+// that they do not get in the way.
+
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define USEC (TIMEFREQ / 1000000)   // timer cycles per microsecond
+
+static uint64
+now(void)
+{
+  uint64 x;
+  asm volatile("rdtime %0" : "=r" (x));
+  return x;
+}
+
+static void
+usage(void)
+{
+  fprintf(2, "usage: rtbench [-l nload] runtime deadline period njobs\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nload = 0, njobs, misses = 0, pids[NCPU];
+  uint64 runtime, deadline, period, release, start, end, jitter;
+  uint64 maxjit = 0, sumjit = 0;
+
+  if(argc > 2 && strcmp(argv[1], "-l") == 0){
+    nload = atoi(argv[2]);
+    if(nload > NCPU)
+      nload = NCPU;
+    argc -= 2;
+    argv += 2;
+  }
+  if(argc != 5)
+    usage();
+  runtime = atoi(argv[1]);
+  deadline = atoi(argv[2]);
+  period = atoi(argv[3]);
+  njobs = atoi(argv[4]);
+  if(runtime == 0 || njobs <= 0)
+    usage();
+
+  for(int i = 0; i < nload; i++){
+    if((pids[i] = fork()) < 0){
+      fprintf(2, "rtbench: fork failed\n");
+      exit(1);
+    }
+    if(pids[i] == 0)
+      for(;;)
+        ;
+  }
+
+  if(sched_setattr(runtime * 1000, deadline * 1000, period * 1000) < 0){
+    fprintf(2, "rtbench: sched_setattr refused\n");
+    for(int i = 0; i < nload; i++)
+      kill(pids[i]);
+    exit(1);
+  }
+
+  // the first job is released by sched_setattr().
+  release = now();
+  for(int k = 0; k < njobs; k++){
+    start = now();
+    jitter = start > release ? start - release : 0;
+    if(jitter > maxjit)
+      maxjit = jitter;
+    sumjit += jitter;
+
+    // use three quarters of the budget.
+    while(now() - start < runtime * USEC * 3 / 4)
+      ;
+    end = now();
+    if(end > release + deadline * USEC)
+      misses++;
+
+    // the next release, skipping periods that have passed
+    // entirely, as the kernel does.
+    release += period * USEC;
+    while(release + period * USEC <= end)
+      release += period * USEC;
+    sched_yield();
+  }
+  sched_setattr(0, 0, 0);
+
+  for(int i = 0; i < nload; i++){
+    kill(pids[i]);
+    wait(0);
+  }
+
+  printf("rtbench: %d jobs, jitter max %d us avg %d us, %d deadline misses\n",
+         njobs, (int)(maxjit / USEC), (int)(sumjit / njobs / USEC), misses);
+  exit(0);
+}
@@ -0,0 +1,151 @@
+// Scheduling latency histograms, from the scheduler trace.
+//
+// schedlat [ticks]
+//
+// Traces the whole system for ticks clock ticks (default
+// 30), then prints log2 histograms, in microseconds, of
+//   wakeup latency: from a process becoming RUNNABLE, after
+//     sleeping or being created, until it runs;
+//   preemption latency: from a process being switched out
+//     while still RUNNABLE until it runs again.
+
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+#define MAXEV   16384
+#define NPEND   256     // a power of two
+#define NBUCKET 20
+#define RUNNABLE 3      // enum procstate in kernel/proc.h
+#define USEC (TIMEFREQ / 1000000)
+
+struct pend {
+  int pid;
+  int wakeup;           // woken, rather than preempted
+  uint64 time;
+};
+
+struct pend pend[NPEND];
+int wakehist[NBUCKET], preempthist[NBUCKET];
+
+// the slot for pid.  pids are handed out in order, so
+// waiting processes seldom collide; if they do, the older
+// one is forgotten.
+static struct pend*
+lookup(int pid)
+{
+  return &pend[pid & (NPEND-1)];
+}
+
+static void
+add(int *hist, uint64 cycles)
+{
+  uint64 us = cycles / USEC;
+  int b = 0;
+
+  while(us > 1 && b < NBUCKET-1){
+    us >>= 1;
+    b++;
+  }
+  hist[b]++;
+}
+
+static void
+print(char *title, int *hist)
+{
+  int max = 0, total = 0;
+
+  for(int b = 0; b < NBUCKET; b++){
+    total += hist[b];
+    if(hist[b] > max)
+      max = hist[b];
+  }
+  printf("%s: %d samples\n", title, total);
+  for(int b = 0; b < NBUCKET; b++){
+    if(hist[b] == 0)
+      continue;
+    printf("%d-%d us\t%d\t", b ? 1 << b : 0, (1 << (b+1)) - 1, hist[b]);
+    for(int i = 0; i < hist[b] * 40 / max; i++)
+      printf("#");
+    printf("\n");
+  }
+}
+
+// shell sort, since each hart's events arrive separately.
+static void
+sort(struct trevent *ev, int n)
+{
+  struct trevent t;
+  int i, j, gap;
+
+  for(gap = n/2; gap > 0; gap /= 2){
+    for(i = gap; i < n; i++){
+      t = ev[i];
+      for(j = i; j >= gap && ev[j-gap].time > t.time; j -= gap)
+        ev[j] = ev[j-gap];
+      ev[j] = t;
+    }
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct trevent *ev, *e;
+  struct pend *p;
+  int ticks, n, m;
+
+  ticks = argc > 1 ? atoi(argv[1]) : 30;
+  if((ev = malloc(MAXEV * sizeof(*ev))) == 0){
+    fprintf(2, "schedlat: out of memory\n");
+    exit(1);
+  }
+
+  // the first call starts tracing.
+  n = 0;
+  if(tracedrain(ev, MAXEV) < 0){
+    fprintf(2, "schedlat: tracedrain failed\n");
+    exit(1);
+  }
+  for(int t = 0; t < ticks && n < MAXEV; t++){
+    sleep(1);
+    if((m = tracedrain(ev + n, MAXEV - n)) > 0)
+      n += m;
+  }
+  tracedrain(0, 0);
+  sort(ev, n);
+
+  for(int i = 0; i < n; i++){
+    e = &ev[i];
+    switch(e->type){
+    case TR_WAKEUP:
+    case TR_FORK:
+      p = lookup(e->pid);
+      p->pid = e->pid;
+      p->wakeup = 1;
+      p->time = e->time;
+      break;
+    case TR_SWITCHOUT:
+      if(e->arg == RUNNABLE){
+        p = lookup(e->pid);
+        p->pid = e->pid;
+        p->wakeup = 0;
+        p->time = e->time;
+      }
+      break;
+    case TR_SWITCHIN:
+      p = lookup(e->pid);
+      if(p->pid == e->pid){
+        add(p->wakeup ? wakehist : preempthist, e->time - p->time);
+        p->pid = 0;
+      }
+      break;
+    }
+  }
+
+  printf("%d events\n", n);
+  print("wakeup latency", wakehist);
+  print("preemption latency", preempthist);
+  exit(0);
+}
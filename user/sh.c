@@ -145,7 +145,7 @@ int
 main(void)
 {
   static char buf[100];
-  int fd;
+  int fd, pid;
 
   // Ensure that three file descriptors are open.
   while((fd = open("console", O_RDWR)) >= 0){
@@ -164,9 +164,17 @@ main(void)
         fprintf(2, "cannot cd %s\n", buf+3);
       continue;
     }
-    if(fork1() == 0)
+    // each command line, a whole pipeline, gets a process
+    // group of its own, which ^C interrupts while it runs.
+    // both set it, since either may run first.
+    if((pid = fork1()) == 0){
+      setpgid(0, 0);
       runcmd(parsecmd(buf));
+    }
+    setpgid(pid, pid);
+    tcsetpgrp(pid);
     wait(0);
+    tcsetpgrp(0);
   }
   exit(0);
 }
@@ -0,0 +1,25 @@
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+// Read up to sz bytes of the kernel's lock statistics
+// into buf.  Returns the number of bytes read, or -1.
+int
+statistics(void *buf, int sz)
+{
+  char tmp[64];
+  int fd, i, n;
+
+  if((fd = open("statistics", O_RDONLY)) < 0)
+    return -1;
+  for(i = 0; i < sz; i += n){
+    if((n = read(fd, (char*)buf + i, sz - i)) <= 0)
+      break;
+  }
+  // read to the end, so the next reader gets a fresh snapshot.
+  if(i == sz)
+    while(read(fd, tmp, sizeof(tmp)) > 0)
+      ;
+  close(fd);
+  return i;
+}
@@ -0,0 +1,195 @@
+// Trace the system calls a command makes.
+//
+// strace [-e call,call,...] command [arg ...]
+//
+// Runs command with trace() set, so that it and the processes
+// it creates record their system calls, by default all of
+// them, or only those named with -e.  Prints one line per call,
+// in the order they returned:
+//   pid: name(a0, a1, a2) = result <microseconds>
+
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/syscall.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+#define MAXEV 4096
+#define USEC (TIMEFREQ / 1000000)
+#define NNAME (sizeof(names) / sizeof(names[0]))
+
+static char *names[] = {
+[SYS_fork]    "fork",
+[SYS_exit]    "exit",
+[SYS_wait]    "wait",
+[SYS_pipe]    "pipe",
+[SYS_read]    "read",
+[SYS_kill]    "kill",
+[SYS_exec]    "exec",
+[SYS_fstat]   "fstat",
+[SYS_chdir]   "chdir",
+[SYS_dup]     "dup",
+[SYS_getpid]  "getpid",
+[SYS_sbrk]    "sbrk",
+[SYS_sleep]   "sleep",
+[SYS_uptime]  "uptime",
+[SYS_open]    "open",
+[SYS_write]   "write",
+[SYS_mknod]   "mknod",
+[SYS_unlink]  "unlink",
+[SYS_link]    "link",
+[SYS_mkdir]   "mkdir",
+[SYS_close]   "close",
+[SYS_nanosleep] "nanosleep",
+[SYS_clone]   "clone",
+[SYS_join]    "join",
+[SYS_futex]   "futex",
+[SYS_sched_setattr] "sched_setattr",
+[SYS_sched_yield] "sched_yield",
+[SYS_getrusage] "getrusage",
+[SYS_procinfo] "procinfo",
+[SYS_tracedrain] "tracedrain",
+[SYS_sysinfo] "sysinfo",
+[SYS_setpgid] "setpgid",
+[SYS_getpgid] "getpgid",
+[SYS_tcsetpgrp] "tcsetpgrp",
+[SYS_setpriority] "setpriority",
+[SYS_getpriority] "getpriority",
+[SYS_ring_setup] "ring_setup",
+[SYS_ring_enter] "ring_enter",
+[SYS_trace]   "trace",
+[SYS_profile] "profile",
+[SYS_profdrain] "profdrain",
+};
+
+static char*
+name(int num)
+{
+  if(num > 0 && num < NNAME && names[num])
+    return names[num];
+  return "???";
+}
+
+static void
+usage(void)
+{
+  fprintf(2, "usage: strace [-e call,call,...] command [arg ...]\n");
+  exit(1);
+}
+
+// the mask of the calls named in the comma-separated list s.
+static uint64
+parsemask(char *s)
+{
+  uint64 mask = 0;
+  char *e;
+  int num, n;
+
+  while(*s){
+    for(e = s; *e && *e != ','; e++)
+      ;
+    n = e - s;
+    for(num = 1; num < NNAME; num++)
+      if(names[num] && strlen(names[num]) == n && memcmp(names[num], s, n) == 0)
+        break;
+    if(num == NNAME){
+      fprintf(2, "strace: unknown system call in %s\n", s);
+      exit(1);
+    }
+    mask |= 1L << num;
+    s = *e ? e + 1 : e;
+  }
+  return mask;
+}
+
+// shell sort, since each hart's events arrive separately.
+static void
+sort(struct trevent *ev, int n)
+{
+  struct trevent t;
+  int i, j, gap;
+
+  for(gap = n/2; gap > 0; gap /= 2){
+    for(i = gap; i < n; i++){
+      t = ev[i];
+      for(j = i; j >= gap && ev[j-gap].time > t.time; j -= gap)
+        ev[j] = ev[j-gap];
+      ev[j] = t;
+    }
+  }
+}
+
+// Print the system call events among ev[0..n-1].  Returns 1
+// if pid's exit is among them.
+static int
+print(struct trevent *ev, int n, int pid)
+{
+  struct trevent *e;
+  int done = 0;
+
+  sort(ev, n);
+  for(int i = 0; i < n; i++){
+    e = &ev[i];
+    if(e->type == TR_EXIT && e->pid == pid)
+      done = 1;
+    if(e->type != TR_SYSCALL)
+      continue;
+    fprintf(2, "%d: %s(0x%x, 0x%x, 0x%x) = %d <%d>\n", e->pid, name(e->arg),
+            (int)e->a[0], (int)e->a[1], (int)e->a[2], e->ret,
+            (int)(e->dur / USEC));
+  }
+  return done;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct trevent *ev;
+  uint64 mask = ~0L;
+  int pid, n, done;
+
+  if(argc > 2 && strcmp(argv[1], "-e") == 0){
+    mask = parsemask(argv[2]);
+    argc -= 2;
+    argv += 2;
+  }
+  if(argc < 2)
+    usage();
+  if((ev = malloc(MAXEV * sizeof(*ev))) == 0){
+    fprintf(2, "strace: out of memory\n");
+    exit(1);
+  }
+
+  // start tracing, so that the command's exit is seen, and
+  // throw away what was there.
+  while(tracedrain(ev, MAXEV) == MAXEV)
+    ;
+
+  if((pid = fork()) < 0){
+    fprintf(2, "strace: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    trace(mask);
+    exec(argv[1], argv + 1);
+    fprintf(2, "strace: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+
+  // drain often, so the rings don't overflow.
+  done = 0;
+  while(!done){
+    nanosleep(10000000);
+    if((n = tracedrain(ev, MAXEV)) < 0){
+      fprintf(2, "strace: tracedrain failed\n");
+      break;
+    }
+    done = print(ev, n, pid);
+  }
+  // and whatever came in since.
+  while((n = tracedrain(ev, MAXEV)) > 0)
+    print(ev, n, pid);
+  tracedrain(0, 0);
+  wait(0);
+  exit(0);
+}
@@ -0,0 +1,56 @@
+// Compare getpid() and uptime(), which read the USYSCALL
+// page, with the system calls they replace.
+//
+// sysbench [n]
+//
+// Makes n calls (default 100000) of each and prints the
+// average time per call in nanoseconds.
+
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define NSEC(cycles) ((cycles) * (1000000000 / TIMEFREQ))
+
+static uint64
+now(void)
+{
+  uint64 x;
+  asm volatile("rdtime %0" : "=r" (x));
+  return x;
+}
+
+static void
+bench(char *name, int (*fn)(void), int n)
+{
+  uint64 start, t;
+  volatile int sink;
+
+  start = now();
+  for(int i = 0; i < n; i++)
+    sink = fn();
+  t = now() - start;
+  (void)sink;
+  printf("%s\t%d ns\n", name, (int)(NSEC(t) / n));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n;
+
+  n = argc > 1 ? atoi(argv[1]) : 100000;
+  if(n <= 0){
+    fprintf(2, "usage: sysbench [n]\n");
+    exit(1);
+  }
+  if(getpid() != getpid_trap()){
+    fprintf(2, "sysbench: USYSCALL page disagrees with the kernel\n");
+    exit(1);
+  }
+  bench("getpid_trap", getpid_trap, n);
+  bench("getpid", getpid, n);
+  bench("uptime_trap", uptime_trap, n);
+  bench("uptime", uptime, n);
+  exit(0);
+}
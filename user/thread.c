@@ -0,0 +1,62 @@
+// Threads, on top of the clone() and join() system calls.
+//
+// Each thread gets a stack of TSTACK bytes from malloc(),
+// which is not thread-safe, so only one thread at a time
+// should create or join threads.
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define TSTACK 8192
+
+// what a new thread should run; kept at the top of its stack.
+struct tstart {
+  void (*fn)(void*);
+  void *arg;
+  char *stack;    // for thread_join() to free
+};
+
+static void
+threadstart(void *a)
+{
+  struct tstart *t = a;
+
+  t->fn(t->arg);
+  exit(0);
+}
+
+// Start a thread running fn(arg).  Returning from fn ends
+// the thread.  Return its id, or -1 on failure.
+int
+thread_create(void (*fn)(void*), void *arg)
+{
+  char *stack;
+  struct tstart *t;
+  int tid;
+
+  if((stack = malloc(TSTACK)) == 0)
+    return -1;
+  // the stack pointer must stay 16-byte aligned.
+  t = (struct tstart*)(((uint64)(stack + TSTACK) - sizeof(*t)) & ~15);
+  t->fn = fn;
+  t->arg = arg;
+  t->stack = stack;
+  if((tid = clone(threadstart, t, t)) < 0){
+    free(stack);
+    return -1;
+  }
+  return tid;
+}
+
+// Wait for thread tid to return, and free its stack.
+// Return tid, or -1 if there is no such thread.
+int
+thread_join(int tid)
+{
+  struct tstart *t;
+
+  if((tid = join(tid, (void**)&t)) < 0)
+    return -1;
+  free(t->stack);
+  return tid;
+}
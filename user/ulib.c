@@ -1,6 +1,10 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
+#include "kernel/futex.h"
+#include "kernel/param.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
 #include "user/user.h"
 
 char*
@@ -134,3 +138,125 @@ memcpy(void *dst, const void *src, uint n)
 {
   return memmove(dst, src, n);
 }
+
+// getpid() and uptime() read the page the kernel maps at
+// USYSCALL instead of trapping; getpid_trap() and
+// uptime_trap() are the system calls.
+int
+getpid(void)
+{
+  struct usyscall *u = (struct usyscall *)USYSCALL;
+
+  if(u->pid == 0)
+    return getpid_trap();
+  return u->pid;
+}
+
+int
+uptime(void)
+{
+  struct usyscall *u = (struct usyscall *)USYSCALL;
+
+  return r_time() / u->tickinterval;
+}
+
+// Mutexes after Drepper, "Futexes Are Tricky": an uncontended
+// lock or unlock is a single atomic instruction, and only a
+// lock that may have sleepers makes a system call to unlock.
+void
+mutex_init(struct mutex *m)
+{
+  m->state = 0;
+}
+
+void
+mutex_lock(struct mutex *m)
+{
+  int c;
+
+  if((c = __sync_val_compare_and_swap(&m->state, 0, 1)) == 0)
+    return;
+  // mark the lock contended, and sleep until it is free.
+  if(c != 2)
+    c = __sync_lock_test_and_set(&m->state, 2);
+  while(c != 0){
+    futex(&m->state, FUTEX_WAIT, 2);
+    c = __sync_lock_test_and_set(&m->state, 2);
+  }
+}
+
+void
+mutex_unlock(struct mutex *m)
+{
+  if(__sync_fetch_and_sub(&m->state, 1) != 1){
+    __sync_lock_release(&m->state);
+    futex(&m->state, FUTEX_WAKE, 1);
+  }
+}
+
+void
+cond_init(struct cond *c)
+{
+  c->seq = 0;
+}
+
+// Atomically release m and wait for a signal, then
+// reacquire m.  May return without a signal, so callers
+// must re-check their condition.
+void
+cond_wait(struct cond *c, struct mutex *m)
+{
+  int seq = c->seq;
+
+  mutex_unlock(m);
+  // a signal after the unlock changes seq, and
+  // futex() returns at once.
+  futex(&c->seq, FUTEX_WAIT, seq);
+  // other waiters may be woken with us, so take
+  // the lock as contended.
+  while(__sync_lock_test_and_set(&m->state, 2) != 0)
+    futex(&m->state, FUTEX_WAIT, 2);
+}
+
+void
+cond_signal(struct cond *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex(&c->seq, FUTEX_WAKE, 1);
+}
+
+void
+cond_broadcast(struct cond *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex(&c->seq, FUTEX_WAKE, 0x7fffffff);
+}
+
+void
+barrier_init(struct barrier *b, int n)
+{
+  mutex_init(&b->lock);
+  cond_init(&b->cv);
+  b->n = n;
+  b->count = 0;
+  b->round = 0;
+}
+
+// Wait until n threads have called barrier_wait().
+void
+barrier_wait(struct barrier *b)
+{
+  int round;
+
+  mutex_lock(&b->lock);
+  round = b->round;
+  if(++b->count == b->n){
+    b->count = 0;
+    b->round++;
+    cond_broadcast(&b->cv);
+  } else {
+    while(b->round == round)
+      cond_wait(&b->cv, &b->lock);
+  }
+  mutex_unlock(&b->lock);
+}
@@ -0,0 +1,47 @@
+// Print how long the system has been up, how many processes
+// there are, and the load averages.
+//
+// uptime [-c]      -c also prints how idle each hart has been.
+
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/sysinfo.h"
+#include "user/user.h"
+
+// print fixed-point x with two decimals.
+static void
+printfixed(uint64 x)
+{
+  x += FIXED_1 / 200;   // round
+  printf("%d.%d%d", (int)(x >> FSHIFT), (int)((x & (FIXED_1-1)) * 10 >> FSHIFT),
+         (int)((x & (FIXED_1-1)) * 100 >> FSHIFT) % 10);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct sysinfo si;
+  int s;
+
+  if(sysinfo(&si) < 0){
+    fprintf(2, "uptime: sysinfo failed\n");
+    exit(1);
+  }
+
+  s = si.uptime / 1000000;
+  printf("up %d:%d%d:%d%d, %d procs, %d running, load average: ",
+         s / 3600, s / 600 % 6, s / 60 % 10, s % 60 / 10, s % 10,
+         si.nproc, si.nrunning);
+  for(int i = 0; i < 3; i++){
+    printfixed(si.loadavg[i]);
+    printf(i < 2 ? ", " : "\n");
+  }
+
+  if(argc > 1 && strcmp(argv[1], "-c") == 0){
+    for(int i = 0; i < si.ncpu && i < NCPU; i++){
+      printf("cpu%d: %d%% idle\n", i,
+             si.uptime ? (int)(si.idle[i] * 100 / si.uptime) : 0);
+    }
+  }
+  exit(0);
+}
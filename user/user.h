@@ -1,5 +1,12 @@
 struct stat;
 struct rtcdate;
+struct rusage;
+struct procinfo;
+struct trevent;
+struct sysinfo;
+struct ring;
+struct ringcqe;
+struct profsample;
 
 // system calls
 int fork(void);
@@ -19,10 +26,30 @@ int link(const char*, const char*);
 int mkdir(const char*);
 int chdir(const char*);
 int dup(int);
-int getpid(void);
+int getpid_trap(void);
 char* sbrk(int);
 int sleep(int);
-int uptime(void);
+int uptime_trap(void);
+int nanosleep(uint64);
+int clone(void(*)(void*), void*, void*);
+int join(int, void**);
+int futex(int*, int, int);
+int sched_setattr(uint64, uint64, uint64);
+int sched_yield(void);
+int getrusage(int, struct rusage*);
+int procinfo(struct procinfo*, int);
+int tracedrain(struct trevent*, int);
+int sysinfo(struct sysinfo*);
+int setpgid(int, int);
+int getpgid(int);
+int tcsetpgrp(int);
+int setpriority(int, int);
+int getpriority(int);
+int ring_setup(struct ring*);
+int ring_enter(int);
+int trace(uint64);
+int profile(int);
+int profdrain(struct profsample*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -40,3 +67,41 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+int getpid(void);
+int uptime(void);
+
+// ulib.c: synchronization between threads, using futex().
+struct mutex {
+  int state;    // 0 unlocked, 1 locked, 2 locked with sleepers
+};
+struct cond {
+  int seq;      // bumped by each signal
+};
+struct barrier {
+  struct mutex lock;
+  struct cond cv;
+  int n;        // threads to wait for
+  int count;    // threads waiting in this round
+  int round;
+};
+void mutex_init(struct mutex*);
+void mutex_lock(struct mutex*);
+void mutex_unlock(struct mutex*);
+void cond_init(struct cond*);
+void cond_wait(struct cond*, struct mutex*);
+void cond_signal(struct cond*);
+void cond_broadcast(struct cond*);
+void barrier_init(struct barrier*, int);
+void barrier_wait(struct barrier*);
+
+// thread.c
+int thread_create(void (*)(void*), void*);
+int thread_join(int);
+
+// statistics.c
+int statistics(void*, int);
+
+// ring.c
+struct ring* ring_init(void);
+int ring_prep(struct ring*, int, int, void*, int, uint64);
+int ring_reap(struct ring*, struct ringcqe*);
@@ -4,9 +4,15 @@
 #include "user/user.h"
 #include "kernel/fs.h"
 #include "kernel/fcntl.h"
+#include "kernel/futex.h"
+#include "kernel/pstat.h"
+#include "kernel/sysinfo.h"
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/ring.h"
+#include "kernel/trace.h"
+#include "kernel/prof.h"
 
 //
 // Tests xv6 system calls.  usertests without arguments runs them all
@@ -2706,6 +2712,881 @@ execout(char *s)
   exit(0);
 }
 
+// nanosleep() should wake up between ticks, so a run of
+// short sleeps must not cost a whole tick each, while
+// sleep() must still wait for its ticks.
+void
+sleeptimes(char *s)
+{
+  int t0 = uptime();
+  for(int i = 0; i < 20; i++){
+    if(nanosleep(1000000) < 0){
+      printf("%s: nanosleep failed\n", s);
+      exit(1);
+    }
+  }
+  int t1 = uptime();
+  if(t1 - t0 >= 10){
+    printf("%s: 20 1ms nanosleeps took %d ticks\n", s, t1 - t0);
+    exit(1);
+  }
+
+  t0 = uptime();
+  if(sleep(3) < 0){
+    printf("%s: sleep failed\n", s);
+    exit(1);
+  }
+  t1 = uptime();
+  if(t1 - t0 < 2){
+    printf("%s: sleep(3) took only %d ticks\n", s, t1 - t0);
+    exit(1);
+  }
+
+  exit(0);
+}
+
+// floating-point registers survive context switches
+// between processes that use them.
+void
+fpregs(char *s)
+{
+  int pids[4];
+
+  for(int i = 0; i < 4; i++){
+    if((pids[i] = fork()) < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pids[i] == 0){
+      volatile double x = 0, inc = 0.25 * (i + 1);
+      for(int j = 0; j < 200000; j++){
+        x += inc;
+        if(j % 50000 == 0)
+          sleep(1);
+      }
+      exit(x == 50000.0 * (i + 1) ? 0 : 1);
+    }
+  }
+  for(int i = 0; i < 4; i++){
+    int xstatus;
+    wait(&xstatus);
+    if(xstatus != 0){
+      printf("%s: lost floating-point state\n", s);
+      exit(1);
+    }
+  }
+  exit(0);
+}
+
+// threads share memory, and exit() of the
+// main thread takes the other threads with it.  one thread
+// can fork while the others change the address space.
+#define NTHR 4
+volatile uint64 thrsum[NTHR];
+volatile int thrstop, thrbad;
+
+void
+thradd(void *arg)
+{
+  uint64 i = (uint64)arg;
+
+  for(int j = 1; j <= 100000; j++)
+    thrsum[i] += j;
+}
+
+void
+thrspin(void *arg)
+{
+  for(;;)
+    ;
+}
+
+void
+thrnop(void *arg)
+{
+}
+
+void
+thrfork(void *arg)
+{
+  int pid, xstatus;
+
+  while(!thrstop){
+    if((pid = fork()) < 0){
+      thrbad = 1;
+      return;
+    }
+    if(pid == 0)
+      exit(0);
+    if(wait(&xstatus) != pid || xstatus != 0){
+      thrbad = 1;
+      return;
+    }
+  }
+}
+
+void
+thrsbrk(void *arg)
+{
+  // only grow, since malloc() takes memory with sbrk() too.
+  for(int i = 0; i < 50 && !thrstop; i++){
+    if(sbrk(PGSIZE) == (char*)-1){
+      thrbad = 1;
+      return;
+    }
+  }
+}
+
+void
+threads(char *s)
+{
+  int tid[NTHR];
+
+  for(int i = 0; i < NTHR; i++){
+    thrsum[i] = 0;
+    if((tid[i] = thread_create(thradd, (void*)(uint64)i)) < 0){
+      printf("%s: thread_create failed\n", s);
+      exit(1);
+    }
+  }
+  for(int i = 0; i < NTHR; i++){
+    if(thread_join(tid[i]) != tid[i]){
+      printf("%s: thread_join failed\n", s);
+      exit(1);
+    }
+    if(thrsum[i] != 5000050000UL){
+      printf("%s: thread %d summed %d\n", s, i, (int)thrsum[i]);
+      exit(1);
+    }
+  }
+  if(thread_join(tid[0]) >= 0){
+    printf("%s: joined a thread twice\n", s);
+    exit(1);
+  }
+
+  thrstop = thrbad = 0;
+  if((tid[0] = thread_create(thrfork, 0)) < 0 ||
+     (tid[1] = thread_create(thrsbrk, 0)) < 0){
+    printf("%s: thread_create failed\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < 50; i++){
+    if((tid[2] = thread_create(thrnop, 0)) < 0 ||
+       thread_join(tid[2]) != tid[2]){
+      printf("%s: thread_create or thread_join failed while forking\n", s);
+      exit(1);
+    }
+  }
+  thrstop = 1;
+  thread_join(tid[0]);
+  thread_join(tid[1]);
+  if(thrbad){
+    printf("%s: fork or sbrk failed while cloning\n", s);
+    exit(1);
+  }
+
+  int pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(int i = 0; i < NTHR; i++)
+      thread_create(thrspin, 0);
+    sleep(1);
+    exit(0);
+  }
+  int xstatus;
+  if(wait(&xstatus) != pid || xstatus != 0){
+    printf("%s: exit with running threads failed\n", s);
+    exit(1);
+  }
+  exit(0);
+}
+
+// one thread closes a pipe's read end while another is
+// blocked reading it.  the reader's read() holds its own
+// reference, so the pipe stays open for reading until that
+// read() returns, and a write still gets through to it.
+int closepfd[2];
+volatile int closegot;
+
+void
+closereader(void *arg)
+{
+  char c;
+
+  closegot = read(closepfd[0], &c, 1);
+}
+
+void
+closeread(char *s)
+{
+  int tid;
+
+  if(pipe(closepfd) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  closegot = -2;
+  if((tid = thread_create(closereader, 0)) < 0){
+    printf("%s: thread_create failed\n", s);
+    exit(1);
+  }
+  // give the reader time to block.
+  sleep(2);
+  if(close(closepfd[0]) != 0){
+    printf("%s: close failed\n", s);
+    exit(1);
+  }
+  if(write(closepfd[1], "x", 1) != 1){
+    printf("%s: write after close failed\n", s);
+    exit(1);
+  }
+  thread_join(tid);
+  if(closegot != 1){
+    printf("%s: blocked read returned %d\n", s, closegot);
+    exit(1);
+  }
+  // now the read end is really gone.
+  if(write(closepfd[1], "x", 1) != -1){
+    printf("%s: write to a pipe with no reader worked\n", s);
+    exit(1);
+  }
+  close(closepfd[1]);
+  exit(0);
+}
+
+// threads growing memory at once must each get their own.
+#define NSBRK 50
+char *sbrkgot[NTHR][NSBRK];
+
+void
+sbrker(void *arg)
+{
+  int t = (int)(uint64)arg;
+
+  for(int i = 0; i < NSBRK; i++)
+    sbrkgot[t][i] = sbrk(PGSIZE);
+}
+
+void
+sbrkthreads(char *s)
+{
+  int tid[NTHR];
+
+  for(int t = 0; t < NTHR; t++){
+    if((tid[t] = thread_create(sbrker, (void*)(uint64)t)) < 0){
+      printf("%s: thread_create failed\n", s);
+      exit(1);
+    }
+  }
+  for(int t = 0; t < NTHR; t++)
+    thread_join(tid[t]);
+  for(int t = 0; t < NTHR; t++){
+    for(int i = 0; i < NSBRK; i++){
+      if(sbrkgot[t][i] == (char*)-1){
+        printf("%s: sbrk failed\n", s);
+        exit(1);
+      }
+      for(int u = 0; u < NTHR; u++)
+        for(int j = 0; j < NSBRK; j++)
+          if((u != t || j != i) && sbrkgot[u][j] == sbrkgot[t][i]){
+            printf("%s: two threads got %p\n", s, sbrkgot[t][i]);
+            exit(1);
+          }
+    }
+  }
+  exit(0);
+}
+
+// threads synchronized with futex()-based
+// mutexes and barriers.
+struct mutex futexmu;
+struct barrier futexbar;
+volatile int futexcount;
+volatile int futexbad;
+
+void
+futexadd(void *arg)
+{
+  for(int round = 0; round < 10; round++){
+    for(int i = 0; i < 1000; i++){
+      mutex_lock(&futexmu);
+      int n = futexcount;
+      if(i % 100 == 0)
+        sleep(0);
+      futexcount = n + 1;
+      mutex_unlock(&futexmu);
+    }
+    barrier_wait(&futexbar);
+    if(futexcount != (round + 1) * 1000 * NTHR)
+      futexbad = 1;
+    barrier_wait(&futexbar);
+  }
+}
+
+void
+futexsync(char *s)
+{
+  int tid[NTHR];
+
+  mutex_init(&futexmu);
+  barrier_init(&futexbar, NTHR);
+  futexcount = 0;
+  futexbad = 0;
+  for(int i = 0; i < NTHR; i++){
+    if((tid[i] = thread_create(futexadd, 0)) < 0){
+      printf("%s: thread_create failed\n", s);
+      exit(1);
+    }
+  }
+  for(int i = 0; i < NTHR; i++)
+    thread_join(tid[i]);
+  if(futexbad){
+    printf("%s: lost updates under the mutex\n", s);
+    exit(1);
+  }
+
+  int x = 1;
+  if(futex(&x, FUTEX_WAIT, 2) >= 0){
+    printf("%s: futex wait on a changed word slept\n", s);
+    exit(1);
+  }
+  exit(0);
+}
+
+// CPU time accounting: spinning shows up as user time, for
+// the process itself and, once reaped, for its parent.
+void
+rusage(char *s)
+{
+  struct rusage ru;
+  struct procinfo *pi;
+  int n, pid, t0, found;
+
+  t0 = uptime();
+  while(uptime() - t0 < 2)
+    ;
+  if(getrusage(RUSAGE_SELF, &ru) < 0 || ru.utime == 0){
+    printf("%s: no user time for spinning\n", s);
+    exit(1);
+  }
+  if(getrusage(2, &ru) >= 0){
+    printf("%s: getrusage accepted a bad who\n", s);
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    t0 = uptime();
+    while(uptime() - t0 < 2)
+      ;
+    exit(0);
+  }
+  wait(0);
+  if(getrusage(RUSAGE_CHILDREN, &ru) < 0 || ru.utime == 0){
+    printf("%s: no user time for the reaped child\n", s);
+    exit(1);
+  }
+
+  pi = malloc(64 * sizeof(*pi));
+  n = procinfo(pi, 64);
+  found = 0;
+  for(int i = 0; i < n; i++)
+    if(pi[i].pid == getpid() && pi[i].ru.utime > 0)
+      found = 1;
+  free(pi);
+  if(!found){
+    printf("%s: procinfo missed the caller\n", s);
+    exit(1);
+  }
+  exit(0);
+}
+
+// kill(-pgid) kills every member of a process group,
+// and only those.
+void
+pgroups(char *s)
+{
+  int pids[3], xst;
+
+  for(int i = 0; i < 3; i++){
+    if((pids[i] = fork()) < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pids[i] == 0){
+      for(;;)
+        sleep(1);
+    }
+  }
+  // the first two form a group; the third stays out of it.
+  if(setpgid(pids[0], 0) < 0 || setpgid(pids[1], pids[0]) < 0){
+    printf("%s: setpgid failed\n", s);
+    exit(1);
+  }
+  if(getpgid(pids[1]) != pids[0] || getpgid(pids[2]) != getpgid(0)){
+    printf("%s: wrong groups\n", s);
+    exit(1);
+  }
+  if(setpgid(1, 0) >= 0){
+    printf("%s: setpgid of a non-child succeeded\n", s);
+    exit(1);
+  }
+
+  if(kill(-pids[0]) < 0){
+    printf("%s: kill(-pgid) failed\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < 2; i++){
+    int pid = wait(&xst);
+    if(pid != pids[0] && pid != pids[1]){
+      printf("%s: wrong process died\n", s);
+      exit(1);
+    }
+  }
+  kill(pids[2]);
+  wait(0);
+  if(kill(-pids[0]) >= 0){
+    printf("%s: kill of an empty group succeeded\n", s);
+    exit(1);
+  }
+  exit(0);
+}
+
+// a low-priority process that holds an inode lock, kept off
+// every hart by middling-priority spinners, must not hold up
+// a high-priority process that wants the same lock for long:
+// it inherits the waiter's priority until it lets go, which
+// must take at most PIWAIT ticks from when the waiter blocks.
+#define PIWAIT 5
+void
+prioinherit(char *s)
+{
+  struct sysinfo si;
+  struct stat st;
+  int low, spin[NCPU], fd, t0, t, worst = 0;
+  static char buf[3*BSIZE];
+
+  if(sysinfo(&si) < 0){
+    printf("%s: sysinfo failed\n", s);
+    exit(1);
+  }
+  unlink("pifile");
+  setpriority(0, 0);
+
+  low = fork();
+  if(low < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(low == 0){
+    setpriority(0, NPRIO-1);
+    for(;;){
+      fd = open("pifile", O_CREATE|O_WRONLY|O_TRUNC);
+      for(int i = 0; i < 40; i++)
+        write(fd, buf, sizeof(buf));
+      close(fd);
+    }
+  }
+  while((fd = open("pifile", O_RDONLY)) < 0)
+    sleep(1);
+
+  t0 = uptime();
+  for(int i = 0; i < si.ncpu; i++){
+    if((spin[i] = fork()) < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(spin[i] == 0){
+      // outlast the fstats below, but give up then, in case
+      // inheritance is broken.
+      setpriority(0, PRIO_DEFAULT/2);
+      while(uptime() - t0 < 10*(1 + PIWAIT))
+        ;
+      exit(0);
+    }
+  }
+
+  for(int i = 0; i < 10; i++){
+    sleep(1);
+    t = uptime();
+    if(fstat(fd, &st) < 0){
+      printf("%s: fstat failed\n", s);
+      exit(1);
+    }
+    if(uptime() - t > worst)
+      worst = uptime() - t;
+  }
+
+  for(int i = 0; i < si.ncpu; i++)
+    kill(spin[i]);
+  kill(low);
+  for(int i = 0; i < si.ncpu + 1; i++)
+    wait(0);
+  close(fd);
+  unlink("pifile");
+  if(worst > PIWAIT){
+    printf("%s: waited %d ticks for a low-priority lock holder\n", s, worst);
+    exit(1);
+  }
+  exit(0);
+}
+
+// several processes look up the same paths at once, sharing
+// the directories' inode locks, while another creates and
+// removes entries in them, which needs the locks exclusively.
+void
+sharedlookup(char *s)
+{
+  struct stat st;
+  int pids[4], xst, fd;
+  char name[] = "rwd/rwe/f0";
+
+  unlink("rwd/rwe/f0");
+  unlink("rwd/rwe/f1");
+  unlink("rwd/rwe");
+  unlink("rwd");
+  if(mkdir("rwd") < 0 || mkdir("rwd/rwe") < 0){
+    printf("%s: mkdir failed\n", s);
+    exit(1);
+  }
+
+  for(int i = 0; i < 4; i++){
+    if((pids[i] = fork()) < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pids[i] == 0){
+      for(int j = 0; j < 200; j++){
+        if(i == 0){
+          // the writer.
+          name[9] = '0' + j % 2;
+          if((fd = open(name, O_CREATE|O_RDWR)) < 0){
+            printf("%s: create %s failed\n", s, name);
+            exit(1);
+          }
+          close(fd);
+          if(unlink(name) < 0){
+            printf("%s: unlink %s failed\n", s, name);
+            exit(1);
+          }
+        } else if(stat("rwd/rwe/../rwe/./..", &st) < 0 || st.type != T_DIR){
+          printf("%s: stat failed\n", s);
+          exit(1);
+        }
+      }
+      exit(0);
+    }
+  }
+  for(int i = 0; i < 4; i++){
+    wait(&xst);
+    if(xst != 0)
+      exit(xst);
+  }
+  if(unlink("rwd/rwe") < 0 || unlink("rwd") < 0){
+    printf("%s: unlink failed\n", s);
+    exit(1);
+  }
+  exit(0);
+}
+
+// kill() finds its victim without locking the pid hash
+// table; it must always find it, even while other processes
+// are being created and freed all the time, changing the
+// hash chains under it.
+void
+killchurn(char *s)
+{
+  int churner, pids[8], pid, xst;
+
+  if((churner = fork()) < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(churner == 0){
+    for(;;){
+      if((pid = fork()) == 0)
+        exit(0);
+      if(pid > 0)
+        wait(0);
+    }
+  }
+
+  for(int round = 0; round < 10; round++){
+    for(int i = 0; i < 8; i++){
+      if((pids[i] = fork()) < 0){
+        printf("%s: fork failed\n", s);
+        exit(1);
+      }
+      if(pids[i] == 0){
+        for(;;)
+          sleep(1);
+      }
+    }
+    for(int i = 0; i < 8; i++){
+      if(kill(pids[i]) < 0){
+        printf("%s: kill of a live child failed\n", s);
+        exit(1);
+      }
+    }
+    for(int i = 0; i < 8; i++){
+      if(wait(&xst) < 0 || xst != -1){
+        printf("%s: child not killed\n", s);
+        exit(1);
+      }
+    }
+  }
+  kill(churner);
+  wait(0);
+  exit(0);
+}
+
+// a batch through the system call ring: create a file, write
+// it, stat it and close it, in one ring_enter(); then open
+// and read it back with a bad close in between, which must
+// fail without stopping the rest.
+void
+ringops(char *s)
+{
+  struct ring *r;
+  struct ringcqe c;
+  struct stat st;
+  char buf[16];
+  int res[8], fd, i;
+
+  if((r = ring_init()) == 0){
+    printf("%s: ring_init failed\n", s);
+    exit(1);
+  }
+  unlink("ringf");
+
+  // the fd open will return, assuming it is the lowest free one.
+  if((fd = open("ringtmp", O_CREATE|O_RDWR)) < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("ringtmp");
+
+  ring_prep(r, RING_OPEN, 0, "ringf", O_CREATE|O_RDWR, 0);
+  ring_prep(r, RING_WRITE, fd, "ringdata", 8, 1);
+  ring_prep(r, RING_FSTAT, fd, &st, 0, 2);
+  ring_prep(r, RING_CLOSE, fd, 0, 0, 3);
+  if(ring_enter(4) != 4){
+    printf("%s: ring_enter failed\n", s);
+    exit(1);
+  }
+  for(i = 0; ring_reap(r, &c); i++){
+    if(c.data != i){
+      printf("%s: completion %d out of order\n", s, i);
+      exit(1);
+    }
+    res[i] = c.res;
+  }
+  if(i != 4 || res[0] != fd || res[1] != 8 || res[2] != 0 || res[3] != 0 ||
+     st.type != T_FILE || st.size != 8){
+    printf("%s: wrong results\n", s);
+    exit(1);
+  }
+
+  ring_prep(r, RING_OPEN, 0, "ringf", O_RDONLY, 0);
+  ring_prep(r, RING_CLOSE, NOFILE, 0, 0, 1);
+  ring_prep(r, RING_READ, fd, buf, sizeof(buf), 2);
+  ring_prep(r, RING_CLOSE, fd, 0, 0, 3);
+  if(ring_enter(4) != 4){
+    printf("%s: ring_enter failed\n", s);
+    exit(1);
+  }
+  for(i = 0; ring_reap(r, &c); i++)
+    res[i] = c.res;
+  if(i != 4 || res[0] != fd || res[1] != -1 || res[2] != 8 || res[3] != 0 ||
+     memcmp(buf, "ringdata", 8) != 0){
+    printf("%s: wrong results reading back\n", s);
+    exit(1);
+  }
+  unlink("ringf");
+  exit(0);
+}
+
+// a ring whose header and first two submissions are on one
+// page and whose completions are on the next, unmapped one:
+// ring_enter() must still report the entry it carried out.
+void
+ringfault(char *s)
+{
+  struct ring *r;
+  char *a;
+
+  a = sbrk(0);
+  sbrk(PGROUNDUP((uint64)a) - (uint64)a + 2*PGSIZE);
+  a = (char*)PGROUNDUP((uint64)a);
+  r = (struct ring*)(a + PGSIZE - __builtin_offsetof(struct ring, sq[2]));
+  if(ring_setup(r) < 0){
+    printf("%s: ring_setup failed\n", s);
+    exit(1);
+  }
+  sbrk(-PGSIZE);
+
+  ring_prep(r, RING_CLOSE, NOFILE, 0, 0, 0);
+  ring_prep(r, RING_CLOSE, NOFILE, 0, 0, 1);
+  if(ring_enter(2) != 1 || r->sqhead != 1 || r->cqtail != 0){
+    printf("%s: ring_enter didn't report the one entry it did\n", s);
+    exit(1);
+  }
+  exit(0);
+}
+
+int upid;
+
+void
+thrgetpid(void *arg)
+{
+  upid = getpid();
+}
+
+// getpid() reads the USYSCALL page, and must agree with the
+// system call, in a thread too; the page is read-only.
+void
+usyscall(char *s)
+{
+  int tid, pid, xst;
+
+  if(getpid() != getpid_trap()){
+    printf("%s: getpid() %d, system call %d\n", s, getpid(), getpid_trap());
+    exit(1);
+  }
+  if((tid = thread_create(thrgetpid, 0)) < 0){
+    printf("%s: thread_create failed\n", s);
+    exit(1);
+  }
+  thread_join(tid);
+  if(upid != tid || getpid() != getpid_trap()){
+    printf("%s: thread getpid() %d, want %d\n", s, upid, tid);
+    exit(1);
+  }
+  if(uptime() < uptime_trap() - 1){
+    printf("%s: uptime() behind the system call\n", s);
+    exit(1);
+  }
+
+  if((pid = fork()) < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    if(getpid() != getpid_trap())
+      exit(1);
+    ((struct usyscall *)USYSCALL)->pid = 1;
+    exit(0);
+  }
+  wait(&xst);
+  if(xst != -1){
+    printf("%s: wrote the USYSCALL page, or wrong pid in child\n", s);
+    exit(1);
+  }
+  exit(0);
+}
+
+// a child traces getpid; its calls must show up in the trace
+// rings with their result, and no other calls.
+void
+systrace(char *s)
+{
+  static struct trevent ev[1024];
+  int pid, n, got = 0;
+
+  tracedrain(ev, sizeof(ev)/sizeof(ev[0]));
+  if((pid = fork()) < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    trace(1L << SYS_getpid);
+    for(int i = 0; i < 10; i++)
+      getpid_trap();
+    uptime_trap();
+    exit(0);
+  }
+  wait(0);
+  while((n = tracedrain(ev, sizeof(ev)/sizeof(ev[0]))) > 0){
+    for(int i = 0; i < n; i++){
+      if(ev[i].type != TR_SYSCALL || ev[i].pid != pid)
+        continue;
+      if(ev[i].arg != SYS_getpid || ev[i].ret != pid){
+        printf("%s: traced call %d returning %d\n", s, ev[i].arg, ev[i].ret);
+        exit(1);
+      }
+      got++;
+    }
+  }
+  tracedrain(0, 0);
+  if(got != 10){
+    printf("%s: %d getpid calls traced, want 10\n", s, got);
+    exit(1);
+  }
+  exit(0);
+}
+
+// the profiler must catch this process spinning in user
+// space, at a pc inside its program.
+void
+profiling(char *s)
+{
+  static struct profsample buf[256];
+  uint64 start;
+  int n, pid = getpid(), got = 0;
+
+  if(profile(1000) < 0){
+    printf("%s: profile failed\n", s);
+    exit(1);
+  }
+  start = r_time();
+  while(r_time() - start < 3 * TICKINTERVAL)
+    ;
+  profile(0);
+  while((n = profdrain(buf, sizeof(buf)/sizeof(buf[0]))) > 0){
+    for(int i = 0; i < n; i++){
+      if(buf[i].pid != pid || !buf[i].user)
+        continue;
+      if(buf[i].depth < 1 || buf[i].pc[0] >= (uint64)sbrk(0)){
+        printf("%s: bad user sample at %p\n", s, buf[i].pc[0]);
+        exit(1);
+      }
+      got++;
+    }
+  }
+  if(got == 0){
+    printf("%s: no samples of this process\n", s);
+    exit(1);
+  }
+  exit(0);
+}
+
+// sysinfo() counts at least this process as running.
+void
+sysinfotest(char *s)
+{
+  struct sysinfo si;
+
+  if(sysinfo(&si) < 0){
+    printf("%s: sysinfo failed\n", s);
+    exit(1);
+  }
+  if(si.nproc < 2 || si.nrunning < 1 || si.nrunning > si.nproc ||
+     si.ncpu < 1 || si.ncpu > NCPU || si.uptime == 0){
+    printf("%s: nonsense: %d procs, %d running, %d cpus\n", s,
+           si.nproc, si.nrunning, si.ncpu);
+    exit(1);
+  }
+  exit(0);
+}
+
 //
 // use sbrk() to count how many free physical memory pages there are.
 // touches the pages to force allocation.
@@ -2873,6 +3754,23 @@ main(int argc, char *argv[])
     {pipe1, "pipe1"},
     {killstatus, "killstatus"},
     {preempt, "preempt"},
+    {sleeptimes, "sleeptimes"},
+    {fpregs, "fpregs"},
+    {threads, "threads"},
+    {closeread, "closeread"},
+    {sbrkthreads, "sbrkthreads"},
+    {futexsync, "futexsync"},
+    {rusage, "rusage"},
+    {sysinfotest, "sysinfo"},
+    {pgroups, "pgroups"},
+    {prioinherit, "prioinherit"},
+    {sharedlookup, "sharedlookup"},
+    {killchurn, "killchurn"},
+    {ringops, "ringops"},
+    {ringfault, "ringfault"},
+    {usyscall, "usyscall"},
+    {systrace, "systrace"},
+    {profiling, "profiling"},
     {exitwait, "exitwait"},
     {rmdot, "rmdot"},
     {fourteen, "fourteen"},
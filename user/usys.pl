@@ -8,8 +8,9 @@ print "#include \"kernel/syscall.h\"\n";
 
 sub entry {
     my $name = shift;
-    print ".global $name\n";
-    print "${name}:\n";
+    my $label = shift || $name;
+    print ".global $label\n";
+    print "${label}:\n";
     print " li a7, SYS_${name}\n";
     print " ecall\n";
     print " ret\n";
@@ -32,7 +33,27 @@ entry("link");
 entry("mkdir");
 entry("chdir");
 entry("dup");
-entry("getpid");
+entry("getpid", "getpid_trap");
 entry("sbrk");
 entry("sleep");
-entry("uptime");
+entry("uptime", "uptime_trap");
+entry("nanosleep");
+entry("clone");
+entry("join");
+entry("futex");
+entry("sched_setattr");
+entry("sched_yield");
+entry("getrusage");
+entry("procinfo");
+entry("tracedrain");
+entry("sysinfo");
+entry("setpgid");
+entry("getpgid");
+entry("tcsetpgrp");
+entry("setpriority");
+entry("getpriority");
+entry("ring_setup");
+entry("ring_enter");
+entry("trace");
+entry("profile");
+entry("profdrain");
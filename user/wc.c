@@ -1,31 +1,74 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/ring.h"
 #include "user/user.h"
 
-char buf[512];
+#define NBUF 8
+
+char buf[NBUF][512];
+struct ring *ring;
+int l, w, c, inword;
 
 void
-wc(int fd, char *name)
+count(char *s, int n)
 {
-  int i, n;
-  int l, w, c, inword;
+  int i;
 
-  l = w = c = 0;
-  inword = 0;
-  while((n = read(fd, buf, sizeof(buf))) > 0){
-    for(i=0; i<n; i++){
-      c++;
-      if(buf[i] == '\n')
-        l++;
-      if(strchr(" \r\t\n\v", buf[i]))
-        inword = 0;
-      else if(!inword){
-        w++;
-        inword = 1;
-      }
+  for(i=0; i<n; i++){
+    c++;
+    if(s[i] == '\n')
+      l++;
+    if(strchr(" \r\t\n\v", s[i]))
+      inword = 0;
+    else if(!inword){
+      w++;
+      inword = 1;
     }
   }
-  if(n < 0){
+}
+
+// Count what is left of fd.  Returns 0, or -1 on error.
+// From a file, each ring_enter() reads the next NBUF blocks,
+// so one trap does the work of NBUF system calls.  A pipe or
+// the console is read a block at a time, since a read there
+// may wait, and there may be nothing after the end.
+int
+countall(int fd)
+{
+  struct stat st;
+  struct ringcqe cqe;
+  int i, n, err, eof;
+
+  if(ring == 0 || fstat(fd, &st) < 0 || st.type != T_FILE){
+    while((n = read(fd, buf[0], sizeof(buf[0]))) > 0)
+      count(buf[0], n);
+    return n;
+  }
+  err = eof = 0;
+  while(!eof && !err){
+    for(i = 0; i < NBUF; i++)
+      ring_prep(ring, RING_READ, fd, buf[i], sizeof(buf[i]), i);
+    if(ring_enter(NBUF) != NBUF)
+      return -1;
+    // completions come in order.
+    while(ring_reap(ring, &cqe)){
+      if(cqe.res < 0)
+        err = 1;
+      else if(cqe.res == 0)
+        eof = 1;
+      else if(!eof && !err)
+        count(buf[cqe.data], cqe.res);
+    }
+  }
+  return err ? -1 : 0;
+}
+
+void
+wc(int fd, char *name)
+{
+  l = w = c = 0;
+  inword = 0;
+  if(countall(fd) < 0){
     printf("wc: read error\n");
     exit(1);
   }
@@ -37,6 +80,7 @@ main(int argc, char *argv[])
 {
   int fd, i;
 
+  ring = ring_init();
   if(argc <= 1){
     wc(0, "");
     exit(0);